@@ -0,0 +1,172 @@
+/** \file Antialias.h
+	Header declaring the adaptive supersampling of generator tiles.
+
+ * A tile is first calculated with a single sample per pixel. Pixels whose
+ * value differs from a neighbour's by more than the contrast threshold,
+ * relative to the larger of the two, are then calculated again with a
+ * stratified grid of samples per axis, and set to their average. Flat
+ * regions, such as the inside of the set, keep their single sample.
+ *
+ * The pixels bordering the tile are calculated too, so pixels along a
+ * tile's edge are compared with their neighbours in the next tiles, and
+ * seams between tiles are supersampled like any other edge.
+ *
+ * When the fractal blackholes its interior, a pixel stays blackholed when
+ * most of its samples are, and otherwise averages its other samples, so the
+ * blackhole value is never blended into the escaped values.
+ */
+
+#pragma once
+
+ // Local
+#include "FractalSpace.h"
+#include "StashData.h"
+#include "typedefs.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace CC
+{
+/**Returns the difference between a and b, relative to the larger of them.*/
+inline fpreal
+relative_contrast(fpreal a, fpreal b)
+{
+	fpreal scale = std::max(std::abs(a), std::abs(b));
+	if (scale == 0.0)
+		return 0.0;
+	return std::abs(a - b) / scale;
+}
+
+/**Supersamples the high contrast pixels of a tile whose values have been
+ * written to dest. Sample is called with the image pixel coordinates of
+ * samples, see FractalSpace::get_fractal_coords(COMPLEX), and writes their
+ * values into its second argument, in the same order. It is called once
+ * for the pixels bordering the tile, and once for the supersamples.
+ * Blackhole is the value of blackholed pixels, or null when the fractal
+ * doesn't blackhole them.*/
+template <typename Sample>
+void
+antialias_tile(
+	TIL_TileList* tileList,
+	TIL_Tile* tile,
+	const AntialiasStashData& settings,
+	fpreal32* dest,
+	Sample& sample,
+	const fpreal32* blackhole = nullptr)
+{
+	if (settings.samples <= 1)
+		return;
+
+	int size_x, size_y;
+	tile->getSize(size_x, size_y);
+	exint num_pixels = static_cast<exint>(size_x) * size_y;
+
+	// The tile's values padded by the pixels bordering it. The corners are
+	// never compared, and aren't calculated.
+	const int pad_x = size_x + 2;
+	std::vector<fpreal32> padded(static_cast<exint>(pad_x) * (size_y + 2));
+	for (int y = 0; y < size_y; y++)
+		std::copy(dest + static_cast<exint>(y) * size_x,
+			dest + static_cast<exint>(y + 1) * size_x,
+			padded.begin() + static_cast<exint>(y + 1) * pad_x + 1);
+
+	WORLDPIXELCOORDS origin = calculate_world_pixel(tileList, tile, 0);
+	std::vector<COMPLEX> coords;
+	std::vector<exint> border;
+
+	for (int x = 0; x < size_x; x++)
+	{
+		coords.emplace_back(origin.first + x, origin.second - 1);
+		border.push_back(x + 1);
+		coords.emplace_back(origin.first + x, origin.second + size_y);
+		border.push_back(static_cast<exint>(size_y + 1) * pad_x + x + 1);
+	}
+	for (int y = 0; y < size_y; y++)
+	{
+		coords.emplace_back(origin.first - 1, origin.second + y);
+		border.push_back(static_cast<exint>(y + 1) * pad_x);
+		coords.emplace_back(origin.first + size_x, origin.second + y);
+		border.push_back(static_cast<exint>(y + 1) * pad_x + size_x + 1);
+	}
+
+	std::vector<fpreal32> values(coords.size());
+	sample(coords, values);
+	for (exint b = 0; b < static_cast<exint>(border.size()); b++)
+		padded[border[b]] = values[b];
+
+	// Mark the tile's pixels in every high contrast pair of neighbours.
+	std::vector<char> marked(num_pixels, 0);
+	auto compare = [&](int x0, int y0, int x1, int y1)
+	{
+		if (relative_contrast(
+			padded[static_cast<exint>(y0 + 1) * pad_x + x0 + 1],
+			padded[static_cast<exint>(y1 + 1) * pad_x + x1 + 1]) <=
+			settings.threshold)
+			return;
+
+		if (x0 >= 0 && y0 >= 0)
+			marked[static_cast<exint>(y0) * size_x + x0] = 1;
+		if (x1 < size_x && y1 < size_y)
+			marked[static_cast<exint>(y1) * size_x + x1] = 1;
+	};
+
+	for (int y = 0; y < size_y; y++)
+		for (int x = -1; x < size_x; x++)
+			compare(x, y, x + 1, y);
+	for (int y = -1; y < size_y; y++)
+		for (int x = 0; x < size_x; x++)
+			compare(x, y, x, y + 1);
+
+	std::vector<exint> pixels;
+	for (exint i = 0; i < num_pixels; i++)
+		if (marked[i])
+			pixels.push_back(i);
+
+	if (pixels.empty())
+		return;
+
+	// Samples sit at the centers of a grid of cells spanning the pixel,
+	// which is centered on its integer coordinates.
+	const int n = settings.samples;
+	const exint per_pixel = static_cast<exint>(n) * n;
+
+	coords.clear();
+	coords.reserve(pixels.size() * per_pixel);
+
+	for (exint pixel : pixels)
+	{
+		WORLDPIXELCOORDS world = calculate_world_pixel(tileList, tile, pixel);
+
+		for (int sy = 0; sy < n; sy++)
+			for (int sx = 0; sx < n; sx++)
+				coords.emplace_back(
+					world.first + (sx + 0.5) / n - 0.5,
+					world.second + (sy + 0.5) / n - 0.5);
+	}
+
+	values.resize(coords.size());
+	sample(coords, values);
+
+	for (exint p = 0; p < static_cast<exint>(pixels.size()); p++)
+	{
+		fpreal sum{ 0.0 };
+		exint holes{ 0 };
+		for (exint s = 0; s < per_pixel; s++)
+		{
+			fpreal32 value = values[p * per_pixel + s];
+			if (blackhole && value == *blackhole)
+				holes++;
+			else
+				sum += value;
+		}
+
+		if (holes * 2 > per_pixel)
+			dest[pixels[p]] = *blackhole;
+		else
+			dest[pixels[p]] = static_cast<fpreal32>(sum / (per_pixel - holes));
+	}
+}
+}  // End of CC Namespace
@@ -0,0 +1,98 @@
+/** \file BigFixed.h
+	Header declaring the arbitrary precision fixed point number used by
+	deep zooms.
+
+ * Deep zooms need a handful of numbers (the view center, and one reference
+ * orbit per frame) with far more precision than fpreal64 offers. BigFixed
+ * stores these as a sign and a magnitude of 32 bit limbs, most significant
+ * first, with a fixed number of integer limbs and as many fractional limbs
+ * as the zoom requires. Only the operations needed to iterate a reference
+ * orbit are supported.
+ */
+
+#pragma once
+
+ // Local
+#include "typedefs.h"
+
+// STL
+#include <string>
+#include <vector>
+
+namespace CC
+{
+/**Number of 32 bit limbs before the binary point. Overflowing them wraps
+ * silently, so callers must keep their values below BIGFIXED_INT_LIMIT.*/
+static const int BIGFIXED_INT_LIMBS{ 2 };
+
+/**Largest magnitude whose sums and products of parts, up to a complex power
+ * of that magnitude, still fit the integer limbs with a bit to spare.
+ * Reference orbits leave BigFixed before any step could reach it.*/
+static const fpreal64 BIGFIXED_INT_LIMIT{
+	static_cast<fpreal64>(uint64(1) << (32 * BIGFIXED_INT_LIMBS - 2)) };
+
+/**Arbitrary precision signed fixed point number.*/
+class BigFixed
+{
+public:
+	/**Creates a zero with the given total number of limbs.*/
+	BigFixed(int limbs = BIGFIXED_INT_LIMBS + 2);
+
+	/**Returns the number of limbs needed to resolve values spaced 'spacing'
+	 * apart, with 64 bits to spare for the error of long orbits.*/
+	static int limbs_for_spacing(fpreal64 spacing);
+
+	/**Exactly converts a double into a number with the given limbs.*/
+	static BigFixed from_double(fpreal64 value, int limbs);
+
+	/**Parses a decimal string such as "-0.7436438870371587047521915" or
+	 * "1.5e-40". Parsing stops at the first invalid character.*/
+	static BigFixed from_string(const std::string& value, int limbs);
+
+	/**Returns the value rounded to double precision.*/
+	fpreal64 to_double() const;
+
+	BigFixed operator+(const BigFixed& other) const;
+	BigFixed operator-(const BigFixed& other) const;
+	BigFixed operator*(const BigFixed& other) const;
+	BigFixed operator-() const;
+
+	int get_limbs() const { return static_cast<int>(limbs.size()); }
+
+private:
+	bool negative{ false };
+	std::vector<uint32> limbs;
+
+	/**Magnitude helpers, ignoring the sign. sub_magnitude requires
+	 * a >= b.*/
+	static int compare_magnitude(const BigFixed& a, const BigFixed& b);
+	static BigFixed add_magnitude(const BigFixed& a, const BigFixed& b);
+	static BigFixed sub_magnitude(const BigFixed& a, const BigFixed& b);
+
+	bool is_zero() const;
+};
+
+/**Complex number with BigFixed parts, used for reference orbits.*/
+struct BigComplex
+{
+	BigFixed real;
+	BigFixed imag;
+
+	BigComplex(int limbs = BIGFIXED_INT_LIMBS + 2) :
+		real(limbs), imag(limbs) {}
+	BigComplex(const BigFixed& real, const BigFixed& imag) :
+		real(real), imag(imag) {}
+
+	/**Exactly converts a double precision complex number.*/
+	static BigComplex from_complex(COMPLEX value, int limbs);
+
+	BigComplex operator+(const BigComplex& other) const;
+	BigComplex operator*(const BigComplex& other) const;
+
+	/**Returns this number raised to a positive integer exponent.*/
+	BigComplex pow(int exponent) const;
+
+	/**Returns the value rounded to double precision.*/
+	COMPLEX to_complex() const;
+};
+}  // End of CC Namespace
@@ -0,0 +1,102 @@
+/** \file BuddhabrotCache.h
+	Header declaring the cache of Buddhabrot histograms kept between cooks.
+
+ * Uniformly sampled Buddhabrots draw sample i from a counter-based generator
+ * or low discrepancy sequence keyed on the seed, so the histogram of the
+ * first n samples is the same however it was reached. Keeping the
+ * unnormalized histogram and its sample count lets a cook asking for more
+ * samples add only the missing ones, and a cook that only changes
+ * normalization skip sampling altogether. The cache is keyed by every input
+ * that changes the histogram besides the number of samples. A cook with a
+ * different key empties it.
+ */
+
+#pragma once
+
+ // Local
+#include "FractalSpace.h"
+#include "StashData.h"
+
+// STL
+#include <vector>
+
+// HDK
+#include <UT/UT_Lock.h>
+
+namespace CC
+{
+/**Inputs that change the histogram of a Buddhabrot, other than the number
+ * of samples.*/
+struct BuddhabrotCacheKey
+{
+	int iters{ 0 };
+	fpreal power{ 2.0 };
+	fpreal bailout{ 2.0 };
+	int jdepth{ 0 };
+	COMPLEX joffset;
+	bool blackhole{ false };
+	bool periodicity{ true };
+	fpreal periodtol{ 0.0 };
+
+	/**Fractal coordinates of the first pixel, and the steps between
+	 * neighbouring pixels, which fix every pixel's coordinates.*/
+	COMPLEX origin;
+	COMPLEX step_x;
+	COMPLEX step_y;
+
+	int size_x{ 0 };
+	int size_y{ 0 };
+	int seed{ 0 };
+	int sampling{ 0 }; /**>Sequence the sample positions are drawn from.*/
+	bool importance{ false }; /**>Whether samples are warped by importance.*/
+	int region{ 0 }; /**>Shape of the domain samples are taken from.*/
+	fpreal regionradius{ 0.0 };
+
+	/**Iteration limit of each Nebulabrot band, empty without them.*/
+	std::vector<int> bands;
+
+	/**The input image, which scales the iterations of every sample.*/
+	std::vector<fpreal32> input;
+
+	BuddhabrotCacheKey() = default;
+	BuddhabrotCacheKey(
+		const MandelbrotStashData& data,
+		const FractalSpace& space,
+		int size_x,
+		int size_y,
+		int seed,
+		int sampling,
+		bool importance,
+		int region,
+		fpreal regionradius,
+		const std::vector<int>& bands,
+		const fpreal32* input);
+
+	bool operator==(const BuddhabrotCacheKey& other) const;
+	bool operator!=(const BuddhabrotCacheKey& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+/**Unnormalized histogram of the samples of the last uniformly sampled cook.
+ * The lock is held while samples are added.*/
+class BuddhabrotCache
+{
+	BuddhabrotCacheKey key;
+
+public:
+	UT_Lock lock;
+	exint samples{ 0 }; /**>Number of samples counted in the histogram.*/
+	/**Counts of every band's pixels, one band after another. Samples count
+	 * as their importance weight when importance sampling.*/
+	std::vector<uint32> histogram;
+
+	/**Empties the cache if it was filled with another key. Called with the
+	 * lock held.*/
+	void set_key(const BuddhabrotCacheKey& key);
+
+	/**Frees the histogram.*/
+	void clear();
+};
+}  // End of CC Namespace
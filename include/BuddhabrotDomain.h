@@ -0,0 +1,50 @@
+/** \file BuddhabrotDomain.h
+	Header declaring the region of the complex plane a Buddhabrot samples.
+
+ * Orbits crossing a zoomed view mostly start far outside of it, so sampling
+ * only the view misses most of what should be drawn there. The domain
+ * decouples where samples are taken from what the image shows: either the
+ * image itself, or a disk around the origin holding the whole set.
+ */
+
+#pragma once
+
+ // Local
+#include "FractalSpace.h"
+
+namespace CC
+{
+/**Shape of the region a Buddhabrot takes its samples from.*/
+enum class BuddhabrotRegion
+{
+	DISK, /**Disk around the origin, |c| < radius.*/
+	IMAGE /**The framing of the image.*/
+};
+
+/**Maps values evenly spread over the unit square onto a region of the
+ * complex plane.*/
+class BuddhabrotDomain
+{
+	BuddhabrotRegion region;
+	fpreal radius;
+	FractalSpace space;
+	int size_x;
+	int size_y;
+
+public:
+	BuddhabrotDomain(
+		BuddhabrotRegion region,
+		fpreal radius,
+		const FractalSpace& space,
+		int size_x,
+		int size_y);
+
+	/**Returns the fractal coordinates of u, v in [0, 1). Evenly spread
+	 * values stay evenly spread over the region. For the image, (0, 0) and
+	 * (1, 1) are the centers of its first and last pixels.*/
+	COMPLEX get_fractal_coords(fpreal64 u, fpreal64 v) const;
+
+	/**Returns whether fractal coordinates lie within the region.*/
+	bool contains(const COMPLEX& c) const;
+};
+}  // End of CC Namespace
@@ -0,0 +1,65 @@
+/** \file BuddhabrotImportance.h
+	Header declaring the importance map used to place Buddhabrot samples.
+
+ * Most samples of a Buddhabrot are deep inside the set, or escape after a
+ * few iterations, and draw next to nothing. The importance map renders a
+ * coarse escape-time grid of the sampled domain first, and warps samples
+ * towards the cells whose orbits are long but still drawn. Each sample is
+ * then weighted by the inverse of its density, so the image converges to
+ * the same result as sampling uniformly.
+ *
+ * Weights are kept as small integers so histograms stay integer counts,
+ * and the warp's densities are derived from them. The weighted counts only
+ * differ from uniform counts by a single scale, see get_scale.
+ */
+
+#pragma once
+
+ // Local
+#include "BuddhabrotDomain.h"
+#include "Mandelbrot.h"
+
+// STL
+#include <vector>
+
+namespace CC
+{
+/**Number of cells along each side of the importance map.*/
+static const int BUDDHABROT_IMPORTANCE_CELLS{ 64 };
+
+/**Largest weight of a sample, which is also the most a cell's density can
+ * be lowered relative to the densest cell. Keeps every cell sampled.*/
+static const uint32 BUDDHABROT_IMPORTANCE_RANGE{ 64 };
+
+/**Piecewise constant distribution over the unit square, built from a coarse
+ * escape-time grid of the fractal.*/
+class BuddhabrotImportance
+{
+	int cells_x{ 0 };
+	int cells_y{ 0 };
+
+	/**Integer weight of each cell, row by row.*/
+	std::vector<uint32> weights;
+
+	/**Cumulative probability of each row, then of each cell within its
+	 * row, one row after another. Each starts at 0 and ends at 1.*/
+	std::vector<fpreal64> row_cdf;
+	std::vector<fpreal64> cell_cdf;
+
+	/**Converts weighted counts to the counts of uniform sampling.*/
+	fpreal64 scale{ 1.0 };
+
+public:
+	/**Calculates the grid over the unit square, mapped onto the domain.*/
+	BuddhabrotImportance(
+		const Mandelbrot& fractal,
+		const BuddhabrotDomain& domain);
+
+	/**Moves u, v in [0, 1) to a position drawn from the map's density,
+	 * keeping uniformly spread values evenly spread within each cell.
+	 * Returns the sample's weight.*/
+	uint32 warp(fpreal64& u, fpreal64& v) const;
+
+	fpreal64 get_scale() const { return scale; }
+};
+}  // End of CC Namespace
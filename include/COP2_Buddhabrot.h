@@ -5,20 +5,62 @@
 #pragma once
 
  // Local
+#include "BuddhabrotCache.h"
+#include "BuddhabrotDomain.h"
+#include "BuddhabrotImportance.h"
 #include "Mandelbrot.h"
 #include "FractalNode.h"
+#include "Random.h"
 
 // HDK
 #include <COP2/COP2_MaskOp.h>
 
-// STL
-#include <random>
-
 namespace CC
 {
 /** A low iteration value that will roughly display the fractal.*/
 static const int REFERENCE_FRACTAL_ITERS{ 10 };
 
+/**Fewest samples given to each task of a Buddhabrot cook, so that small
+ * cooks don't pay for a histogram per thread.*/
+static const exint BUDDHABROT_MIN_TASK_SAMPLES{ 4096 };
+
+/**Memory the Buddhabrot may spend on a histogram per task, above which its
+ * tasks share a single histogram. */
+static const exint BUDDHABROT_HISTOGRAM_BYTES{ exint(1) << 30 };
+
+/**Iteration bands of a Nebulabrot, drawn into the red, green and blue
+ * channels.*/
+static const int NEBULABROT_BANDS{ 3 };
+
+/**Points of an orbit mapped to output pixels at once.*/
+static const int BUDDHABROT_ORBIT_CHUNK{ 64 };
+
+/**Most Markov chains run by Metropolis-Hastings sampling.*/
+static const exint BUDDHABROT_CHAINS{ 32 };
+
+/**Uniform samples each Markov chain tries before giving up on finding an
+ * orbit that reaches the image.*/
+static const exint BUDDHABROT_SEED_TRIES{ 10000 };
+
+/**Chance of a Markov chain proposing a fresh uniform sample, rather than a
+ * small move from its current sample.*/
+static const fpreal BUDDHABROT_LARGE_STEP{ 0.2 };
+
+/**Largest small move of a Markov chain, in pixels.*/
+static const fpreal BUDDHABROT_MUTATION_RADIUS{ 4.0 };
+
+/**Ratio of the largest small move to the smallest.*/
+static const fpreal BUDDHABROT_MUTATION_RANGE{ 4096.0 };
+
+/**How the Buddhabrot chooses the positions of its samples.*/
+enum class BuddhabrotSampling
+{
+	UNIFORM, /**Scattered evenly across the image.*/
+	METROPOLIS, /**Markov chains favouring orbits that land in the image.*/
+	SOBOL, /**Owen scrambled Sobol sequence.*/
+	HALTON /**Halton sequence with a random rotation.*/
+};
+
 /**Small object storing both the Fractal and the Transformation space info.
  * This is necessary because its values are copied to each tile, so the data
  * within can be sourced a single time, but accessed many times across multiple
@@ -31,9 +73,17 @@ struct COP2_BuddhabrotData : public COP2_ContextData
 	UT_Lock myLock;
 	int seed;
 	fpreal samples;
+	BuddhabrotSampling sampling;
+	bool importance; /**>Warps samples by an importance map.*/
+	BuddhabrotRegion region; /**>Where samples are taken from.*/
+	fpreal regionradius; /**>Radius of the disk region.*/
 	bool normalize;
 	int maxval;
 	bool displayreffractal;
+	bool nebulabrot;
+	int bands[NEBULABROT_BANDS]; /**>Iteration limit of each band.*/
+	/**The node's histogram cache, when Cache Samples is enabled.*/
+	BuddhabrotCache* sample_cache{ nullptr };
 
 	COP2_BuddhabrotData() = default;
 	virtual ~COP2_BuddhabrotData() = default;
@@ -93,11 +143,18 @@ public:
 		const COP2_CookAreaList& input_areas,
 		COP2_CookAreaList& needed_areas);
 
-	/** Calculates Set of Fractal Set Coords Based on fractalCoords Position*/
-	std::vector<COMPLEX> buddhabrotPoints(
-		Mandelbrot* fractal,
+	/** Returns the number of points of the orbit of c to draw. With the
+	 * blackhole on, these are the points before it escapes, or none if it
+	 * doesn't escape within nIterations, or if none of them land inside a
+	 * size_x by size_y image of space. Iterates without storing any
+	 * points.*/
+	int buddhabrotLength(
+		Mandelbrot& fractal,
 		const COMPLEX& c,
-		unsigned int nIterations);
+		int nIterations,
+		const FractalSpace& space,
+		int size_x,
+		int size_y);
 
 	/**Accessor used to construct this object in register.cpp*/
 	friend class OP;
@@ -129,16 +186,61 @@ private:
 		const char* name,
 		OP_Operator* entry);
 
+	/** Calls splat with the output pixel of each point of the orbit of c,
+	 * in fractal coordinates, which lands inside the image, along with a
+	 * mask of the bands drawing the point. Samples outside of the image
+	 * take their input multiplier from its nearest edge pixel. Drawn orbits
+	 * are iterated a second time rather than stored, see buddhabrotLength.
+	 * Without the Nebulabrot, the only band is the first. */
+	template <typename Splat>
+	void COP2_Buddhabrot::splatOrbit(
+		COP2_BuddhabrotData* sdata,
+		const COP2_Context& context,
+		const char* idata,
+		Mandelbrot& fractal,
+		const COMPLEX& c,
+		Splat splat);
+
 	/** Creates the Buddhabrot, and sets values For image idata and odata,
 	 * whichcalls to the inputs and outputs of a TIL_Region.
-	 * Returns highest sampled value. */
-	int COP2_Buddhabrot::evaluateBuddhabrot(
+	 * Samples are taken from the domain of the region parms, which may
+	 * extend past the image, and counted against the whole domain.
+	 * Samples are spread over threads, and each sample's position is a
+	 * function of the seed and its index, drawn from a Philox generator or
+	 * a low discrepancy sequence, so the image doesn't depend on the thread
+	 * count.
+	 * Every band is accumulated from the same samples, each into its own
+	 * odata, which may be null. With importance sampling, samples are warped
+	 * by a BuddhabrotImportance map and weighted to match uniform sampling.
+	 * With a cache, only the samples it's missing are taken, and its
+	 * histogram is updated.
+	 * Returns highest sampled value of each band. */
+	std::vector<fpreal32> COP2_Buddhabrot::evaluateBuddhabrot(
 		COP2_BuddhabrotData* sdata,
 		const COP2_Context& context,
 		char* idata,
-		char* odata,
-		std::mt19937& rng,
-		const int numSamples);
+		const std::vector<char*>& odata,
+		const exint numSamples,
+		BuddhabrotCache* cache);
+
+	/** Creates the Buddhabrot as evaluateBuddhabrot, but with samples from
+	 * Markov chains whose states are accepted in proportion to how many of
+	 * their orbit's points land in the image. Each orbit is weighted by the
+	 * inverse of that count, and the image rescaled by the mean count of
+	 * uniform samples of the domain, so it converges to the uniformly
+	 * sampled image.
+	 * Returns highest sampled value of each band. */
+	std::vector<fpreal32> COP2_Buddhabrot::metropolisBuddhabrot(
+		COP2_BuddhabrotData* sdata,
+		const COP2_Context& context,
+		char* idata,
+		const std::vector<char*>& odata,
+		const exint numSamples);
+
+	/** Returns the highest value of each band's odata.*/
+	std::vector<fpreal32> COP2_Buddhabrot::highestSampleValues(
+		const COP2_Context& context,
+		const std::vector<char*>& odata);
 
 	/** Normalizes the buddhabrot fractal based on either a user-defined
 	 * maximum, or the highest Value sampled by the Buddhabrot. */
@@ -146,7 +248,7 @@ private:
 		COP2_BuddhabrotData* sdata,
 		const COP2_Context& context,
 		char* odata,
-		int highest_sample_value);
+		fpreal32 highest_sample_value);
 
 	/** Display a Mandelbrot fractal to guide the user.
 	 * Note that the input masking is taken into account. */
@@ -156,5 +258,9 @@ private:
 		char* idata,
 		char* odata,
 		Mandelbrot& refFractal);
+
+	/**Histogram of the last uniformly sampled cook, when Cache Samples is
+	 * enabled.*/
+	BuddhabrotCache sample_cache;
 };
 }
\ No newline at end of file
@@ -5,8 +5,10 @@
 #pragma once
 
  // Local
+#include "Antialias.h"
 #include "Lyapunov.h"
 #include "FractalSpace.h"
+#include "Progressive.h"
 
 // HDK
 #include <COP2/COP2_Generator.h>
@@ -47,6 +49,10 @@ protected:
 
 	/** Generates the image. This is a multi-threaded call. */
 	OP_ERROR generateTile(COP2_Context& context, TIL_TileList* tileList);
+
+private:
+	/**Values of the tiles left coarse by the last interactive cooks.*/
+	ProgressiveCache<std::vector<fpreal32>> progressive_cache;
 };
 
 /**Small object storing both the Fractal and the Transformation space info.
@@ -58,6 +64,16 @@ struct COP2_LyapunovData : public COP2_ContextData
 	FractalSpace space; /**> The transformation space of the Lyapunov.*/
 	Lyapunov fractal; /**> The Lyapunov fractal calculator.*/
 
+	/**Whether tiles are refined coarse to fine until the deadline.*/
+	bool progressive{ false };
+	CookDeadline deadline;
+
+	/**Whether a tile stopped early, and a refining recook was scheduled.*/
+	std::atomic<bool> refining{ false };
+
+	/**Supersampling of high contrast pixels.*/
+	AntialiasStashData antialias;
+
 	COP2_LyapunovData() = default;
 	virtual ~COP2_LyapunovData();
 };
@@ -5,16 +5,45 @@
 #pragma once
 
  // Local
+#include "Antialias.h"
+#include "DeepZoom.h"
 #include "FractalSpace.h"
 #include "Mandelbrot.h"
 #include "FractalNode.h"
+#include "OrbitCache.h"
+#include "Progressive.h"
 
 // HDK
 #include <COP2/COP2_Generator.h>
+#include <UT/UT_Lock.h>
+
+// STL
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
 
 
 namespace CC
 {
+/**Iteration counts and values of a progressive tile's pixels, kept while
+ * the tile is refined over several cooks.*/
+struct MandelbrotProgressiveSamples
+{
+	std::vector<int> num_iter;
+	std::vector<fpreal64> values;
+};
+
+/**Splats both of a progressive tile's results, see refine_progressive_tile.*/
+inline void
+splat_tile(
+	MandelbrotProgressiveSamples& samples,
+	const std::vector<exint>& sources)
+{
+	splat_tile(samples.num_iter, sources);
+	splat_tile(samples.values, sources);
+}
+
 /**Mandelbrot Operator class. Inherits from COP2_Generator, meaning it will
  * cook in tiles. See 'COP Concepts' in the HDK documentation.*/
 class COP2_Mandelbrot : public COP2_Generator
@@ -50,14 +79,62 @@ protected:
 	virtual OP_ERROR generateTile(
 		COP2_Context& context, TIL_TileList* tilelist);
 
+	/** Used to disable parameters. */
+	virtual bool updateParmsFlags() override;
+
 	virtual ~COP2_Mandelbrot();
+
+private:
+	/**Orbits of the last cooks, when Cache Orbits is enabled.*/
+	OrbitCache orbit_cache;
+
+	/**Tiles left coarse by the last interactive cooks.*/
+	ProgressiveCache<MandelbrotProgressiveSamples> progressive_cache;
 };
 
 /**Enumerates the different valid return types a Mandelbrot can have.*/
 enum MandelbrotMode
 {
 	SMOOTH, /**Returns the image as logarithmically smoothed.*/
-	RAW /**Returns the 'raw', unmodified output. Has integer banding.*/
+	RAW, /**Returns the 'raw', unmodified output. Has integer banding.*/
+	DISTANCE, /**Returns the estimated distance to the set, in pixels.*/
+	NORMALIZED /**Returns the normalized iteration count. Faster than SMOOTH.*/
+};
+
+/**Optional planes written alongside the main plane, from the same orbit
+ * pass. MAIN_PLANE stands for the main plane, and every other plane the
+ * generator adds.*/
+enum MandelbrotPlane
+{
+	ITERATIONS_PLANE, /**Raw iteration count.*/
+	SMOOTH_PLANE, /**Smooth value, as the SMOOTH or NORMALIZED mode.*/
+	Z_PLANE, /**Final value of z, as real and imaginary components.*/
+	ARGUMENT_PLANE, /**Argument of the final z, 0-1.*/
+	DISTANCE_PLANE, /**Distance estimate, in pixels.*/
+	STRIPE_PLANE, /**Stripe average of the orbit.*/
+	TRAP_PLANE, /**Closest approach of the orbit to the trap point.*/
+	NORMAL_PLANE, /**Normal of the set's potential, from dz/dc.*/
+	MAIN_PLANE,
+	NUM_MANDELBROT_PLANES
+};
+
+/**Orbit pass results of a tile, stored as the values written to each of
+ * its planes, so every plane of a tile is written from a single pass.*/
+struct MandelbrotTileCache
+{
+	UT_Lock lock;
+	bool calculated{ false };
+
+	/**Components of each MandelbrotPlane, in tile order.*/
+	std::vector<fpreal32> planes[NUM_MANDELBROT_PLANES][3];
+
+	/**Planes that haven't been written yet. The tile is released from the
+	 * cache once they all have.*/
+	int unwritten{ 0 };
+
+	/**Order the tile was added to the cache in, so the oldest tiles can be
+	 * evicted when planes are left unwritten.*/
+	exint stamp{ 0 };
 };
 
 /**Small object storing both the Fractal and the Transformation space info.
@@ -68,10 +145,64 @@ struct COP2_MandelbrotData : public COP2_ContextData
 {
 	FractalSpace space;
 	Mandelbrot fractal;
+	DeepZoom deep; /**Replaces space when enabled.*/
 	MandelbrotMode mode{ MandelbrotMode::SMOOTH };
 	bool fit{ true }; /**'Fit's the values into a 0-1 range.*/
 
+	/**Size of a pixel in fractal coordinates, for DISTANCE mode.*/
+	fpreal pixel_size{ 1.0 };
+
+	/**Fills tile regions enclosed by a uniform border without calculating
+	 * them. See BoundaryTracer in COP2_Mandelbrot.cpp.*/
+	bool trace{ false };
+
+	/**Scalar type the fractal is iterated in, the same for every tile of
+	 * the cook. Deep zooms always use DeepZoom's own precision.*/
+	Precision precision{ Precision::DOUBLE };
+
+	/**Writes a tile's pixel values from its iterations and values. Selected
+	 * for mode and fit once per cook, so pixels don't test them again.*/
+	typedef void(*ShadeFunction)(
+		const COP2_MandelbrotData& data,
+		const int* num_iter,
+		const fpreal64* values,
+		exint size,
+		fpreal32* dest);
+	ShadeFunction shade{ nullptr };
+
+	/**Whether tiles are refined coarse to fine until the deadline. Deep
+	 * zooms, boundary tracing and extra planes calculate tiles fully.*/
+	bool progressive{ false };
+	CookDeadline deadline;
+
+	/**Whether a tile stopped early, and a refining recook was scheduled.*/
+	std::atomic<bool> refining{ false };
+
+	/**Supersampling of high contrast pixels. Deep zooms and extra planes
+	 * aren't supersampled.*/
+	AntialiasStashData antialias;
+
+	/**The node's orbit cache when Cache Orbits is enabled and applies to
+	 * the cook, or null.*/
+	OrbitCache* orbit_cache{ nullptr };
+
+	/**Whether each extra MandelbrotPlane was added to the sequence. When any
+	 * was, every plane is written from MandelbrotTileCaches.*/
+	bool planes[NUM_MANDELBROT_PLANES]{};
+	bool extra_planes{ false };
+	OrbitFeatureSettings features;
+
+	/**Tiles with planes left to write, by the tile's lower left pixel.
+	 * Cooks that don't request every plane leave tiles behind, so only the
+	 * newest are kept, see acquire_tile.*/
+	std::map<std::pair<int, int>, std::shared_ptr<MandelbrotTileCache>> tiles;
+	exint tiles_stamp{ 0 };
+	UT_Lock tiles_lock;
+
 	COP2_MandelbrotData() = default;
 	virtual ~COP2_MandelbrotData();
+
+	/**Shared by every plane, so that they can share the tile cache.*/
+	virtual bool createPerPlane() const override { return false; }
 };
 }
@@ -5,9 +5,12 @@
 #pragma once
 
  // Local
+#include "Antialias.h"
+#include "DeepZoom.h"
 #include "FractalSpace.h"
 #include "Mandelbrot.h"
 #include "FractalNode.h"
+#include "Progressive.h"
 
 // HDK
 #include <COP2/COP2_Generator.h>
@@ -54,6 +57,10 @@ protected:
 	virtual bool updateParmsFlags() override;
 
 	virtual ~COP2_Pickover();
+
+private:
+	/**Values of the tiles left coarse by the last interactive cooks.*/
+	ProgressiveCache<std::vector<fpreal32>> progressive_cache;
 };
 
 /**Small object storing both the Fractal and the Transformation space info.
@@ -64,6 +71,7 @@ struct COP2_PickoverData : public COP2_ContextData
 {
 	FractalSpace space;
 	Pickover fractal;
+	DeepZoom deep; /**Replaces space when enabled.*/
 
 	/**Calculates the reference fractal.*/
 	fpreal32 calculate_reference(
@@ -72,6 +80,18 @@ struct COP2_PickoverData : public COP2_ContextData
 	/** The pixel-space location of the pickover point position.*/
 	WORLDPIXELCOORDS world_point;
 
+	/**Whether tiles are refined coarse to fine until the deadline. Deep
+	 * zooms are always calculated fully.*/
+	bool progressive{ false };
+	CookDeadline deadline;
+
+	/**Whether a tile stopped early, and a refining recook was scheduled.*/
+	std::atomic<bool> refining{ false };
+
+	/**Supersampling of high contrast pixels. Deep zooms aren't
+	 * supersampled.*/
+	AntialiasStashData antialias;
+
 	COP2_PickoverData() = default;
 	virtual ~COP2_PickoverData();
 };
@@ -0,0 +1,142 @@
+/** \file DeepZoom.h
+	Header declaring the perturbation engine used for deep zooms.
+
+ * Past a scale of roughly 1e-13, neighbouring pixels share the same double
+ * precision coordinates. Deep zooms avoid this by iterating a single
+ * reference orbit Z at the view center in arbitrary precision (see
+ * BigFixed.h), then iterating every pixel as a small double precision
+ * offset from it:
+ *
+ *     z = Z + d,   d' = (Z + d)^N - Z^N + dc
+ *
+ * where dc is the pixel's offset from the center, which fits comfortably in
+ * a double at any zoom.
+ *
+ * Where a pixel's orbit passes much closer to zero than the reference's,
+ * the offset loses its precision ("glitches"). These pixels are detected
+ * with Pauldelbrot's criterion |Z + d| < 1e-3 |Z|, and recalculated around a
+ * new reference orbit taken from one of the glitched pixels.
+ *
+ * For the canonical z^2 + c, the offsets of the first iterations are nearly
+ * polynomial in dc, and are shared by the whole image. These are skipped by
+ * a cubic series approximation d = A dc + B dc^2 + C dc^3.
+ */
+
+#pragma once
+
+ // Local
+#include "BigFixed.h"
+#include "Mandelbrot.h"
+#include "StashData.h"
+
+// STL
+#include <vector>
+
+namespace CC
+{
+/**Number of reference orbits a single batch may use, including the view
+ * center's, before its remaining glitched pixels are left as they are.*/
+static const int DEEPZOOM_MAX_REFERENCES{ 8 };
+
+/**Orbit iterated in arbitrary precision, stored rounded to double precision
+ * for pixels to be perturbed around.*/
+struct ReferenceOrbit
+{
+	/**Z after every step of the formula, Julia steps included. Step j of
+	 * iteration n is stored at n * (jdepth + 1) + j.*/
+	std::vector<COMPLEX> z;
+
+	/**Number of whole iterations stored. Shorter than the iteration limit
+	 * when the reference itself escaped.*/
+	int length{ 0 };
+
+	/**Smooth sums exp(-|Z|) after each number of iterations, starting from
+	 * the initial value of 1. Used in place of the skipped iterations.*/
+	std::vector<fpreal> smooth;
+
+	/**Iterations skipped by the series approximation, and its coefficients
+	 * there. The coefficients are scaled by powers of series_radius, so
+	 * they stay in double range at any zoom.*/
+	int skip{ 0 };
+	COMPLEX series_a, series_b, series_c;
+	fpreal series_radius{ 1.0 };
+};
+
+/**Deep zoom view and reference orbit of a single frame. This is built once
+ * per cook, in newContextData, and only read while cooking tiles.*/
+class DeepZoom
+{
+public:
+	DeepZoom() = default;
+
+	/**Parses the view, and iterates the reference orbit at its center. The
+	 * series approximation is fitted to the whole image.*/
+	DeepZoom(
+		const DeepZoomStashData& deepData,
+		const MandelbrotStashData& fractalData,
+		int image_x,
+		int image_y);
+
+	/**Whether the deep zoom view should be used. Fractional exponents
+	 * aren't supported, and fall back to the regular view.*/
+	bool is_enabled() const;
+
+	/**Returns a pixel's offset from the view center.*/
+	COMPLEX get_delta(WORLDPIXELCOORDS pixel_coords) const;
+
+	/**Returns fractal coordinates rounded to double precision. Only for
+	 * things that don't need the full precision, like reference images.*/
+	COMPLEX get_fractal_coords(COMPLEX delta) const;
+
+	/**Returns the pixel nearest to fractal coordinates rounded to double
+	 * precision. See get_fractal_coords.*/
+	WORLDPIXELCOORDS get_pixel_coords(COMPLEX fractal_coords) const;
+
+	/**Calculates pixels given by their offsets from the view center,
+	 * writing the values Mandelbrot::calculate would.*/
+	void calculate(
+		const COMPLEX* deltas, exint size, FractalCoordsInfo* results) const;
+
+	/**Calculates pixels given by their offsets from the view center,
+	 * writing the values Mandelbrot::calculate_distance would. The
+	 * estimates are taken at the bailout rather than settled.*/
+	void calculate_distance(
+		const COMPLEX* deltas, exint size, FractalCoordsInfo* results) const;
+
+	/**Returns the distance between pixels in fractal coordinates.*/
+	fpreal get_spacing() const { return spacing; }
+
+	/**Calculates pixels given by their offsets from the view center,
+	 * writing the values Pickover::calculate would. Orbits stop measuring
+	 * distances once they escape, as their offsets are meaningless after.*/
+	void calculate(
+		const COMPLEX* deltas, exint size, Pickover& fractal,
+		FractalCoordsInfo* results) const;
+
+private:
+	bool enabled{ false };
+	MandelbrotStashData data;
+	int power{ 2 };
+
+	/**View center, and the distance between pixels.*/
+	BigComplex center;
+	fpreal spacing{ 1.0 };
+	int image_x{ 0 };
+	int image_y{ 0 };
+
+	/**Reference orbit at the view center.*/
+	ReferenceOrbit reference;
+
+	/**Iterates the reference orbit at center + offset. The series
+	 * approximation is only fitted when series_radius is positive.*/
+	void calculate_reference(
+		COMPLEX offset, fpreal series_radius, ReferenceOrbit& orbit) const;
+
+	/**Calculates the batch for the exponent N, re-referencing glitched
+	 * pixels. Visitor accumulates the colour of each orbit.*/
+	template <int N, typename Visitor>
+	void calculate_batch(
+		const COMPLEX* deltas, exint size, Visitor& visitor,
+		FractalCoordsInfo* results) const;
+};
+}  // End of CC Namespace
@@ -0,0 +1,166 @@
+/** \file DoubleDouble.h
+	Header defining the double-double number used by mid-depth zooms.
+
+ * A DoubleDouble stores a value as the unevaluated sum of two fpreal64s,
+ * hi + lo, where |lo| <= ulp(hi) / 2. This gives about 106 bits of
+ * precision, reaching zooms of roughly 1e-28 for a fraction of the cost of
+ * BigFixed. Arithmetic is built from the error-free transformations of
+ * Dekker and Knuth, which rely on every operation being rounded on its own.
+ * Sources using this type must be compiled without FMA contraction (see
+ * CMakeLists.txt).
+ */
+
+#pragma once
+
+ // Local
+#include "typedefs.h"
+
+namespace CC
+{
+/**Number stored as the unevaluated sum hi + lo.*/
+struct DoubleDouble
+{
+	fpreal64 hi{ 0.0 };
+	fpreal64 lo{ 0.0 };
+
+	DoubleDouble() = default;
+	DoubleDouble(fpreal64 hi, fpreal64 lo = 0.0) : hi(hi), lo(lo) {}
+
+	/**Returns the value rounded to double precision.*/
+	fpreal64 to_double() const { return hi + lo; }
+};
+
+/**Returns a + b exactly as a DoubleDouble (Knuth's two-sum).*/
+inline DoubleDouble
+two_sum(fpreal64 a, fpreal64 b)
+{
+	fpreal64 s = a + b;
+	fpreal64 bb = s - a;
+	return DoubleDouble(s, (a - (s - bb)) + (b - bb));
+}
+
+/**two_sum, only valid when |a| >= |b|.*/
+inline DoubleDouble
+quick_two_sum(fpreal64 a, fpreal64 b)
+{
+	fpreal64 s = a + b;
+	return DoubleDouble(s, b - (s - a));
+}
+
+/**Returns a * b exactly as a DoubleDouble, splitting each factor into two
+ * 26 bit halves whose products are exact (Dekker's two-product).*/
+inline DoubleDouble
+two_prod(fpreal64 a, fpreal64 b)
+{
+	const fpreal64 split = 134217729.0; // 2^27 + 1
+
+	fpreal64 p = a * b;
+
+	fpreal64 t = split * a;
+	fpreal64 a_hi = t - (t - a);
+	fpreal64 a_lo = a - a_hi;
+
+	t = split * b;
+	fpreal64 b_hi = t - (t - b);
+	fpreal64 b_lo = b - b_hi;
+
+	fpreal64 e = ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+	return DoubleDouble(p, e);
+}
+
+inline DoubleDouble
+operator+(const DoubleDouble& a, const DoubleDouble& b)
+{
+	DoubleDouble s = two_sum(a.hi, b.hi);
+	DoubleDouble t = two_sum(a.lo, b.lo);
+	s = quick_two_sum(s.hi, s.lo + t.hi);
+	return quick_two_sum(s.hi, s.lo + t.lo);
+}
+
+inline DoubleDouble
+operator-(const DoubleDouble& a)
+{
+	return DoubleDouble(-a.hi, -a.lo);
+}
+
+inline DoubleDouble
+operator-(const DoubleDouble& a, const DoubleDouble& b)
+{
+	return a + (-b);
+}
+
+inline DoubleDouble
+operator*(const DoubleDouble& a, const DoubleDouble& b)
+{
+	DoubleDouble p = two_prod(a.hi, b.hi);
+	return quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+/**Complex number with DoubleDouble parts. std::complex is only specified
+ * for the built in floating point types.*/
+struct ComplexDD
+{
+	DoubleDouble real;
+	DoubleDouble imag;
+
+	ComplexDD() = default;
+	ComplexDD(const DoubleDouble& real, const DoubleDouble& imag) :
+		real(real), imag(imag) {}
+	explicit ComplexDD(const COMPLEX& value) :
+		real(value.real()), imag(value.imag()) {}
+
+	/**Returns the value rounded to double precision.*/
+	COMPLEX to_complex() const
+	{
+		return COMPLEX(real.to_double(), imag.to_double());
+	}
+};
+
+inline ComplexDD
+operator+(const ComplexDD& a, const ComplexDD& b)
+{
+	return ComplexDD(a.real + b.real, a.imag + b.imag);
+}
+
+inline ComplexDD
+operator-(const ComplexDD& a, const ComplexDD& b)
+{
+	return ComplexDD(a.real - b.real, a.imag - b.imag);
+}
+
+/**Multiplies two complex numbers, as complex_mult in Mandelbrot.h.*/
+inline ComplexDD
+complex_mult(const ComplexDD& a, const ComplexDD& b)
+{
+	return ComplexDD(
+		a.real * b.real - a.imag * b.imag,
+		a.real * b.imag + a.imag * b.real);
+}
+
+/**Raises z to an integer exponent known at compile time, as ipow in
+ * Mandelbrot.h.*/
+template <int N>
+inline ComplexDD
+ipow_dd(const ComplexDD& z)
+{
+	ComplexDD half = ipow_dd<N / 2>(z);
+	ComplexDD squared = complex_mult(half, half);
+	return N % 2 ? complex_mult(squared, z) : squared;
+}
+
+template <>
+inline ComplexDD
+ipow_dd<1>(const ComplexDD& z)
+{
+	return z;
+}
+
+/**z^0. Only instantiated for the generic kernel, which calculate_dd never
+ * reaches, but it keeps that instantiation from recursing.*/
+template <>
+inline ComplexDD
+ipow_dd<0>(const ComplexDD& z)
+{
+	return ComplexDD(COMPLEX(1.0));
+}
+}  // End of CC Namespace
@@ -24,11 +24,40 @@ struct FractalCoordsInfo
 	COMPLEX z;
 	fpreal smooth;
 
+	/**Estimated distance to the fractal's boundary, in fractal coordinates.
+	 * 0 when not estimated, or for points inside the set.*/
+	fpreal distance{ 0.0 };
+
 	FractalCoordsInfo(
 		int num_iter = 0,
 		COMPLEX z = COMPLEX(),
-		fpreal smooth = 0.0) :
-		num_iter(num_iter), z(z), smooth(smooth) {}
+		fpreal smooth = 0.0,
+		fpreal distance = 0.0) :
+		num_iter(num_iter), z(z), smooth(smooth), distance(distance) {}
+};
+
+/**Structure-of-arrays output of Fractal::calculate_batch, holding the
+ * values of a FractalCoordsInfo for each coordinate of a batch. Arrays left
+ * null aren't written, which lets fractals skip work only they need.*/
+struct FractalBatchInfo
+{
+	int* num_iter{ nullptr };
+	fpreal64* smooth{ nullptr };
+	fpreal64* z_real{ nullptr };
+	fpreal64* z_imag{ nullptr };
+
+	/**Writes the values of a single coordinate at index i.*/
+	void write(exint i, const FractalCoordsInfo& info) const
+	{
+		if (num_iter)
+			num_iter[i] = info.num_iter;
+		if (smooth)
+			smooth[i] = info.smooth;
+		if (z_real)
+			z_real[i] = info.z.real();
+		if (z_imag)
+			z_imag[i] = info.z.imag();
+	}
 };
 
 /**Base class for fractals. */
@@ -46,5 +75,22 @@ public:
 	 * can theoretically cook any Fractal.
 	 */
 	virtual FractalCoordsInfo calculate(COMPLEX coords) = 0;
+
+	/** Calculates a contiguous batch of 'size' coordinates, given as
+	 * separate real and imaginary arrays, writing the values calculate
+	 * would into 'results'. Nodes should prefer this to calculate, as it
+	 * costs a single virtual call for the whole batch, and lets fractals
+	 * hoist their setup out of the loop or vectorize it. This default just
+	 * calls calculate for each coordinate.
+	 */
+	virtual void calculate_batch(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		const FractalBatchInfo& results)
+	{
+		for (exint i = 0; i < size; i++)
+			results.write(i, calculate(COMPLEX(real[i], imag[i])));
+	}
 };
 } // End of CC Namespace
\ No newline at end of file
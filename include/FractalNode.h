@@ -47,6 +47,23 @@ static PRM_Name nameBailout{ BAILOUT_NAME.first, BAILOUT_NAME.second };
 static PRM_Name nameJDepth{ JDEPTH_NAME.first, JDEPTH_NAME.second };
 static PRM_Name nameJOffset{ JOFFSET_NAME.first, JOFFSET_NAME.second };
 static PRM_Name nameBlackhole{ BLACKHOLE_NAME.first, BLACKHOLE_NAME.second };
+static PRM_Name namePeriodicity{
+	PERIODICITY_NAME.first, PERIODICITY_NAME.second };
+static PRM_Name namePeriodTol{ PERIODTOL_NAME.first, PERIODTOL_NAME.second };
+
+// Deep Zoom Name Data
+static PRM_Name nameDeepZoom{ DEEPZOOM_NAME.first, DEEPZOOM_NAME.second };
+static PRM_Name nameDeepCenter{ DEEPCENTER_NAME.first, DEEPCENTER_NAME.second };
+static PRM_Name nameDeepScale{ DEEPSCALE_NAME.first, DEEPSCALE_NAME.second };
+static PRM_Name nameDeepSeries{ DEEPSERIES_NAME.first, DEEPSERIES_NAME.second };
+
+// Progressive Name Data
+static PRM_Name nameProgressive{ PROGRESSIVE_NAME.first, PROGRESSIVE_NAME.second };
+static PRM_Name nameBudget{ BUDGET_NAME.first, BUDGET_NAME.second };
+
+// Antialias Name Data
+static PRM_Name nameAASamples{ AASAMPLES_NAME.first, AASAMPLES_NAME.second };
+static PRM_Name nameAAThreshold{ AATHRESHOLD_NAME.first, AATHRESHOLD_NAME.second };
 
 // Pickover Name Data
 static PRM_Name namePoPoint(
@@ -148,6 +165,29 @@ static PRM_Default defaultBailout{ 4 };
 static PRM_Default defaultJDepth{ 0 };
 static PRM_Default defaultJOffset[] = { 0, 0 };
 static PRM_Default defaultBlackhole{ false };
+static PRM_Default defaultPeriodicity{ true };
+
+/** Small enough that orbits merely passing close to an earlier point of
+ * their own, without being truly periodic, are very unlikely to match. */
+static PRM_Default defaultPeriodTol{ 1e-12 };
+
+// Deep Zoom Defaults Data
+/** Frames the whole Mandelbrot set. These are strings, so that they can hold
+ * more digits than a double. */
+static PRM_Default defaultDeepCenter[] =
+{
+	PRM_Default(0, "-0.75"),
+	PRM_Default(0, "0")
+};
+static PRM_Default defaultDeepScale(0, "3.5");
+
+// Progressive Defaults Data
+/** Milliseconds, short enough to keep the viewer interactive. Renders
+ * aren't progressive, see ProgressiveStashData. */
+static PRM_Default defaultBudget{ 250 };
+
+// Antialias Defaults Data
+static PRM_Default defaultAAThreshold{ 0.1 };
 
 // Define Pickover Defaults
 static PRM_Default defaultPoRefSize{ 10.0 };
@@ -197,6 +237,32 @@ static PRM_Range rangeJDepth
 	PRM_RangeFlag::PRM_RANGE_UI, 5
 };
 
+static PRM_Range rangePeriodTol
+{
+	PRM_RangeFlag::PRM_RANGE_RESTRICTED, 0,
+	PRM_RangeFlag::PRM_RANGE_UI, 1e-6
+};
+
+// Progressive Ranges
+static PRM_Range rangeBudget
+{
+	PRM_RangeFlag::PRM_RANGE_RESTRICTED, 0,
+	PRM_RangeFlag::PRM_RANGE_UI, 2000
+};
+
+// Antialias Ranges
+static PRM_Range rangeAASamples
+{
+	PRM_RangeFlag::PRM_RANGE_RESTRICTED, 1,
+	PRM_RangeFlag::PRM_RANGE_UI, 4
+};
+
+static PRM_Range rangeAAThreshold
+{
+	PRM_RangeFlag::PRM_RANGE_RESTRICTED, 0,
+	PRM_RangeFlag::PRM_RANGE_UI, 1
+};
+
 // Lyapunov Ranges
 
 static PRM_Range rangeLyaStartValue
@@ -258,6 +324,9 @@ static PRM_Template multiparmXformTemps[] =
 
 // Create separator names. These are shared across the CCFS
 static PRM_Name nameSeparatorMandelbrot("sep_mandelbrot", "Sep Mandelbrot");
+static PRM_Name nameSeparatorDeepZoom("sep_deepzoom", "Sep Deep Zoom");
+static PRM_Name nameSeparatorProgressive("sep_progressive", "Sep Progressive");
+static PRM_Name nameSeparatorAntialias("sep_antialias", "Sep Antialias");
 static PRM_Name nameSepA("sep_A", "Sep A");
 static PRM_Name nameSepB("sep_B", "Sep B");
 static PRM_Name nameSepC("sep_C", "Sep C");
@@ -295,7 +364,7 @@ static PRM_Name nameSepC("sep_C", "Sep C");
 		&nameRotate, PRMzeroDefaults, 0, &rangeRotate)
 
    /** Macro for creating Mandelbrot Templates.
-	* Add 7 to COP_SWITCHER calls
+	* Add 9 to COP_SWITCHER calls
 	*/
 #define TEMPLATES_MANDELBROT \
 	PRM_Template(PRM_INT_J, TOOL_PARM, 1, \
@@ -306,6 +375,10 @@ static PRM_Name nameSepC("sep_C", "Sep C");
 		&nameBailout, &defaultBailout, 0, &rangeBailout), \
 	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, \
 		&nameBlackhole, PRMzeroDefaults), \
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, \
+		&namePeriodicity, &defaultPeriodicity), \
+	PRM_Template(PRM_FLT_LOG, TOOL_PARM, 1, \
+		&namePeriodTol, &defaultPeriodTol, 0, &rangePeriodTol), \
 	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, \
 		&nameSeparatorMandelbrot, PRMzeroDefaults), \
 	PRM_Template(PRM_INT_J, TOOL_PARM, 1, \
@@ -313,6 +386,46 @@ static PRM_Name nameSepC("sep_C", "Sep C");
 	PRM_Template(PRM_FLT_J, TOOL_PARM, 2, \
 		&nameJOffset, PRMzeroDefaults)
 
+	/** Macro for creating Deep Zoom Templates, whose view replaces the
+	 * xforms when enabled. See DeepZoom.h.
+	 * Add 5 to COP_SWITCHER calls.
+	 */
+#define TEMPLATES_DEEPZOOM \
+	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, \
+		&nameSeparatorDeepZoom, PRMzeroDefaults), \
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, \
+		&nameDeepZoom, PRMzeroDefaults), \
+	PRM_Template(PRM_STRING, TOOL_PARM, 2, \
+		&nameDeepCenter, defaultDeepCenter), \
+	PRM_Template(PRM_STRING, TOOL_PARM, 1, \
+		&nameDeepScale, &defaultDeepScale), \
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, \
+		&nameDeepSeries, PRMoneDefaults)
+
+	/** Macro for creating Progressive Templates, which refine tiles coarse
+	 * to fine until the time budget runs out. See Progressive.h.
+	 * Add 3 to COP_SWITCHER calls.
+	 */
+#define TEMPLATES_PROGRESSIVE \
+	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, \
+		&nameSeparatorProgressive, PRMzeroDefaults), \
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, \
+		&nameProgressive, PRMzeroDefaults), \
+	PRM_Template(PRM_FLT_J, TOOL_PARM, 1, \
+		&nameBudget, &defaultBudget, 0, &rangeBudget)
+
+	/** Macro for creating Antialias Templates, which supersample the high
+	 * contrast pixels of each tile. See Antialias.h.
+	 * Add 3 to COP_SWITCHER calls.
+	 */
+#define TEMPLATES_ANTIALIAS \
+	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, \
+		&nameSeparatorAntialias, PRMzeroDefaults), \
+	PRM_Template(PRM_INT_J, TOOL_PARM, 1, \
+		&nameAASamples, PRMoneDefaults, 0, &rangeAASamples), \
+	PRM_Template(PRM_FLT_J, TOOL_PARM, 1, \
+		&nameAAThreshold, &defaultAAThreshold, 0, &rangeAAThreshold)
+
 	/** Macro for creating Pickover Templates.
 	 * Add 6 to COP_SWITCHER calls.
 	 * Pickovers are dependent on TEMPLATES_MANDELBROT also being declared
@@ -8,6 +8,7 @@
 #pragma once
 
  // Local
+#include "DoubleDouble.h"
 #include "typedefs.h"
 #include "StashData.h"
 
@@ -25,6 +26,19 @@
 
 namespace CC
 {
+/**Number of bits of precision kept below the size of a pixel when
+ * choosing a Precision. Error grows as orbits are iterated, so the
+ * coordinates alone being resolved isn't enough.*/
+static const int PRECISION_HEADROOM_BITS{ 12 };
+
+/**Scalar types the fractal kernels can iterate in, cheapest first.*/
+enum class Precision
+{
+	SINGLE, /**fpreal32, only through the vectorized engine.*/
+	DOUBLE, /**fpreal64.*/
+	DOUBLE_DOUBLE /**DoubleDouble, for zooms past roughly 1e-12.*/
+};
+
 /**Get the Houdini rstOrder enum value from the interface.*/
 RSTORDER get_rst_order(const int val);
 
@@ -42,6 +56,8 @@ WORLDPIXELCOORDS calculate_world_pixel(
 	TIL_Tile* tile,
 	int pixel_index);
 
+class TileCoords;
+
 /**Object that stores and manipulates the overall 'offset'
  * between the transformation space, and the desired viewing
  * space of a fractal.
@@ -61,9 +77,24 @@ class FractalSpace
 	/**> Container for the literal data used to transform the post_matrix.*/
 	XformStashData xdata;
 
+	/**Pixel coordinates map to fractal coordinates by the affine
+	 * origin + y * step_y + x * step_x, collapsed from the image size and
+	 * post_matrix whenever either changes.*/
+	COMPLEX origin;
+	COMPLEX step_x;
+	COMPLEX step_y;
+
+	/**Rows of the inverse of the mapping's steps. The pixel x coordinate of
+	 * c is the dot product of inverse_x and c - origin, likewise for y.*/
+	COMPLEX inverse_x;
+	COMPLEX inverse_y;
+
+	/**Recalculates origin, step_x and step_y, and their inverse.*/
+	void update_mapping();
+
 	/**Private method which implements the get_fractal_coords
 	 * methods to reduce code duplication. */
-	COMPLEX _get_fractal_coords(COMPLEX pixel_coords);
+	COMPLEX _get_fractal_coords(COMPLEX pixel_coords) const;
 
 public:
 
@@ -77,19 +108,58 @@ public:
 	/** Return the fractal coordinates, which use the size of the image
 	 * as a relative size. The scale is 0-1 in the x axis of the image.
 	 */
-	COMPLEX get_fractal_coords(WORLDPIXELCOORDS pixel_coords);
+	COMPLEX get_fractal_coords(WORLDPIXELCOORDS pixel_coords) const;
 
 	/**Returns fractal coordinates, but with input coordinates that
 	 * were determined from double precision values, and not inteter
 	 * pixels. Primarily used by the Buddhabrot where 'sample' values
 	 * may not directly match a pixel. See COP2_Buddhabrot for more
 	 * details.*/
-	COMPLEX get_fractal_coords(COMPLEX pixel_coords);
-
-	/**get_pixel_coords is only configured to work with the Buddhabrot,
-	 * and may not work with non-default transformation orders or
-	 * xforms with non-zero pivot points.*/
-	WORLDPIXELCOORDS get_pixel_coords(COMPLEX fractal_coords);
+	COMPLEX get_fractal_coords(COMPLEX pixel_coords) const;
+
+	/**Returns fractal coordinates in double-double precision. Pixels are
+	 * offset from the view's origin, which is exact in double precision,
+	 * so neighbouring pixels stay distinct far past the zoom where
+	 * get_fractal_coords returns the same coordinates for them.*/
+	ComplexDD get_fractal_coords_dd(WORLDPIXELCOORDS pixel_coords);
+
+	/**get_fractal_coords_dd, with image coordinates that aren't whole
+	 * pixels, such as supersamples.*/
+	ComplexDD get_fractal_coords_dd(COMPLEX pixel_coords);
+
+	/**Returns DOUBLE, or DOUBLE_DOUBLE when double precision can't resolve
+	 * every pixel between min and max, comparing the size of a pixel
+	 * against the magnitude of the coordinates. See
+	 * PRECISION_HEADROOM_BITS. SINGLE changes results, so it's never
+	 * chosen here.*/
+	Precision get_precision(WORLDPIXELCOORDS min, WORLDPIXELCOORDS max);
+
+	/**Returns the image coordinates of fractal coordinates, the inverse
+	 * of get_fractal_coords for every transformation order and xform
+	 * chain. Unlike get_pixel_coords, these aren't rounded to a pixel.*/
+	COMPLEX get_image_coords(COMPLEX fractal_coords) const;
+
+	/**Returns the pixel containing the fractal coordinates, the inverse of
+	 * get_fractal_coords for every transformation order and xform chain.
+	 * Pixels are centered on their integer coordinates, as in DeepZoom.*/
+	WORLDPIXELCOORDS get_pixel_coords(COMPLEX fractal_coords) const;
+
+	/**Writes the index, x + y * size_x, of the pixel containing each of
+	 * count fractal coordinates, or -1 where it falls outside of a size_x
+	 * by size_y image. Used to map whole orbits at once.*/
+	void get_pixel_indices(
+		const COMPLEX* coords,
+		exint count,
+		int size_x,
+		int size_y,
+		exint* indices) const;
+
+	/**Returns the fractal coordinates of pixel (0, 0).*/
+	COMPLEX get_origin() const { return origin; }
+	/**Returns the change in fractal coordinates per pixel in x.*/
+	COMPLEX get_step_x() const { return step_x; }
+	/**Returns the change in fractal coordinates per pixel in y.*/
+	COMPLEX get_step_y() const { return step_y; }
 
 	/**Returns in fractal coords at the bottom-left most pixel. */
 	COMPLEX get_minimum();
@@ -111,4 +181,29 @@ public:
 
 };
 
+/**Fractal coordinates of every pixel of a tile. Rows and columns are each
+ * mapped once, after which a pixel is its row's coordinates plus its
+ * column's offset, the same values FractalSpace::get_fractal_coords returns
+ * without its per pixel multiplies.*/
+class TileCoords
+{
+	int size_x{ 0 };
+	std::vector<COMPLEX> rows; /**>Coordinates of each row's first pixel.*/
+	std::vector<COMPLEX> columns; /**>Offset of each column from the first.*/
+
+public:
+	TileCoords(const FractalSpace& space, TIL_TileList* tiles, TIL_Tile* tile);
+
+	/**Returns the coordinates of pixel x, y of the tile.*/
+	COMPLEX at(int x, int y) const { return rows[y] + columns[x]; }
+
+	/**Returns the coordinates of a pixel given by its index in the tile.*/
+	COMPLEX operator[](exint pixel_index) const
+	{
+		exint y = pixel_index / size_x;
+		return at(static_cast<int>(pixel_index - y * size_x),
+			static_cast<int>(y));
+	}
+};
+
 } // End of CC Namespace
\ No newline at end of file
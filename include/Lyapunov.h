@@ -30,6 +30,14 @@ public:
 
 	FractalCoordsInfo calculate(COMPLEX coords);
 
+	/**Calculates a batch, sharing the sequence buffers between all of its
+	 * coordinates rather than allocating them for each one.*/
+	virtual void calculate_batch(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		const FractalBatchInfo& results) override;
+
 	/**Returns a sequence of values based on data.seq.
 	 * When seq is equal to zero, 'X' is returned, and when seq is equal to one
 	 * 'Y' returned. All other values are linearly interpretpreted between 'X'
@@ -37,5 +45,14 @@ public:
 	 * values has the effect of 'rotating' a spike in the Lyapunov image.
 	 */
 	std::vector<fpreal> generate_sequence(fpreal x, fpreal y);
+
+protected:
+	/**Returns the Lyapunov value at x and y. preseq and seq are working
+	 * buffers, resized as needed, so they can be reused between calls.*/
+	fpreal calculate_value(
+		fpreal x,
+		fpreal y,
+		std::vector<fpreal>& preseq,
+		std::vector<fpreal>& seq);
 };
 }
\ No newline at end of file
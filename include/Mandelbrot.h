@@ -5,6 +5,7 @@
 #pragma once
 
  // Local
+#include "DoubleDouble.h"
 #include "Fractal.h"
 #include "FractalSpace.h"
 
@@ -17,6 +18,153 @@
 
 namespace CC
 {
+/**Multiplies two complex numbers. std::complex's operator* guards against
+ * inf and nan results (C99 Annex G), which is needless work inside an
+ * escape-time loop that bails out long before values overflow.*/
+inline COMPLEX
+complex_mult(const COMPLEX& a, const COMPLEX& b)
+{
+	return COMPLEX(
+		a.real() * b.real() - a.imag() * b.imag(),
+		a.real() * b.imag() + a.imag() * b.real());
+}
+
+/**Raises z to an integer exponent known at compile time through repeated
+ * squaring, rather than std::pow's complex exp and log.*/
+template <int N>
+inline COMPLEX
+ipow(const COMPLEX& z)
+{
+	COMPLEX half = ipow<N / 2>(z);
+	COMPLEX squared = complex_mult(half, half);
+	return N % 2 ? complex_mult(squared, z) : squared;
+}
+
+template <>
+inline COMPLEX
+ipow<1>(const COMPLEX& z)
+{
+	return z;
+}
+
+/**Exponent used by the fractal kernels. N is the exponent selected by
+ * MandelbrotStashData::get_kernel_power, where 0 is the generic kernel that
+ * falls back to std::pow for fractional exponents.*/
+template <int N>
+inline COMPLEX
+kernel_pow(const COMPLEX& z, fpreal power)
+{
+	return ipow<N>(z);
+}
+
+template <>
+inline COMPLEX
+kernel_pow<0>(const COMPLEX& z, fpreal power)
+{
+	return std::pow(z, power);
+}
+
+/**Derivative of kernel_pow, N z^(N-1), used to track dz/dc.*/
+template <int N>
+inline COMPLEX
+kernel_dpow(const COMPLEX& z, fpreal power)
+{
+	return static_cast<fpreal>(N) * ipow<N - 1>(z);
+}
+
+template <>
+inline COMPLEX
+kernel_dpow<0>(const COMPLEX& z, fpreal power)
+{
+	return power * std::pow(z, power - 1.0);
+}
+
+/**Returns the exterior distance estimate |z| ln|z| / |dz/dc| of an escaped
+ * orbit, which approaches the distance to the set as |z| grows.*/
+inline fpreal
+distance_estimate(const COMPLEX& z, const COMPLEX& dz)
+{
+	fpreal dz_abs = std::abs(dz);
+	if (dz_abs == 0.0)
+		return 0.0;
+
+	fpreal z_abs = std::abs(z);
+	return z_abs * std::log(z_abs) / dz_abs;
+}
+
+/**Returns the normalized iteration count of an orbit that escaped after
+ * 'iterations' bounded iterations with the final value z:
+ *
+ *     mu = iterations + 1 - log(log|z| / log(bailout)) / log(degree)
+ *
+ * where degree is the growth of |z| per iteration, power^(jdepth + 1).
+ * Unlike the exponential sum, this only needs the escape value. Orbits that
+ * never escaped return their iterations unchanged.*/
+inline fpreal
+normalized_iterations(
+	int iterations,
+	int max_iterations,
+	const COMPLEX& z,
+	fpreal log_bailout,
+	fpreal log_degree)
+{
+	if (iterations < 0 || iterations >= max_iterations)
+		return iterations;
+
+	fpreal log_z = 0.5 * std::log(std::norm(z));
+	if (log_z <= 0.0 || log_bailout <= 0.0 || log_degree <= 0.0)
+		return iterations;
+
+	return iterations + 1.0 - std::log(log_z / log_bailout) / log_degree;
+}
+
+/**Values gathered along an orbit besides its FractalCoordsInfo, for the
+ * extra planes of COP2_Mandelbrot. See Mandelbrot::calculate_features.*/
+struct OrbitFeatures
+{
+	COMPLEX dz; /**Derivative of z with respect to c, where the orbit ended.*/
+	fpreal stripe{ 0.0 }; /**Stripe average of the bounded iterations, 0-1.*/
+	fpreal trap{ 0.0 }; /**Closest approach of the orbit to the trap point.*/
+};
+
+/**Settings of Mandelbrot::calculate_features.*/
+struct OrbitFeatureSettings
+{
+	/**Number of stripes the stripe average wraps around each orbit point.*/
+	fpreal stripe_density{ 5.0 };
+
+	/**Point the orbit trap measures the orbit's distance to.*/
+	COMPLEX trap_point{ 0.0 };
+
+	/**Whether escaped orbits settle a distance estimate, as with
+	 * Mandelbrot::calculate_distance.*/
+	bool distance{ false };
+};
+
+/**Iteration state of a pixel's orbit, kept between cooks by OrbitCache so
+ * that raising the iterations only continues the orbits still bounded.
+ * See Mandelbrot::calculate_resume.*/
+struct OrbitState
+{
+	enum Status : unsigned char
+	{
+		UNSTARTED, /**Not iterated yet.*/
+		BOUNDED, /**Hadn't escaped when the iterations ran out.*/
+		ESCAPED, /**Escaped after 'iterations' bounded iterations.*/
+		INTERIOR /**Found to be inside the set, and never escapes.*/
+	};
+
+	COMPLEX z;
+	fpreal smooth{ 0.0 }; /**Exponential smoothing sum so far.*/
+	int iterations{ 0 };
+	Status status{ UNSTARTED };
+};
+
+/**Highest Julia depth given its own unrolled kernels. Deeper Julia sets use
+ * the kernels for KERNEL_JULIA_ANY, which loop over data.jdepth.*/
+static const int MAX_KERNEL_JULIA{ 2 };
+static const int KERNEL_JULIA_ANY{ -1 };
+
 /**Class implementing the Mandelbrot fractal.
  * It is being treated as a 'principled mandelbrot', where as far as
  * is sensibles, the formula was opened up and parameterized so that it
@@ -28,20 +176,220 @@ class Mandelbrot : public Fractal
 public:
 	MandelbrotStashData data;
 
-	Mandelbrot() = default;
+	/**Distance estimate, in fractal coordinates, beyond which an escaped
+	 * orbit's first estimate is kept rather than settled. 0 settles every
+	 * estimate.*/
+	fpreal distance_cutoff{ 0.0 };
+
+	Mandelbrot();
 	Mandelbrot(MandelbrotStashData& mandelData);
 
 	virtual ~Mandelbrot();
 
-	/**Calculates the Mandelbrot fractal.*/
+	/**Calculates the Mandelbrot fractal. Points the interior test
+	 * blackholes return a z of 0, see interior_test.*/
 	virtual FractalCoordsInfo calculate(COMPLEX coords) override;
 
+	/**Calculates a batch with the vectorized engine when the CPU and
+	 * exponent allow it and iteration counts are requested, or with the
+	 * exponent's kernel otherwise.*/
+	virtual void calculate_batch(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		const FractalBatchInfo& results) override;
+
+	/**calculate_batch, iterating the vectorized engine in the given
+	 * precision. DOUBLE_DOUBLE needs coordinates in that precision, see
+	 * calculate_dd, and is calculated in double precision here.*/
+	void calculate_batch(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		const FractalBatchInfo& results,
+		Precision precision);
+
 	/**Calculate Z runs only the fractal math calculation. This is
 	 * distinct from the calculate member in that calculate initializes
 	 * some data, and sets the return type conditions. This has been
 	 * separated so that this class can be subclassed, and still use
 	 * Mandelbrot-like fractals without duplicating the fundamental math.*/
 	COMPLEX calculate_z(COMPLEX z, COMPLEX c);
+
+	/**calculate_z, that also advances dz, the derivative of z with respect
+	 * to c, used for distance estimates.*/
+	COMPLEX calculate_z(COMPLEX z, COMPLEX c, COMPLEX& dz);
+
+	/**Calculates the Mandelbrot fractal like calculate, while also
+	 * estimating each escaped pixel's distance to the set. Escaped orbits
+	 * keep iterating past the bailout only until the estimate settles.
+	 * Smooth values aren't calculated.*/
+	FractalCoordsInfo calculate_distance(COMPLEX coords);
+
+	/**Calculates the Mandelbrot fractal like calculate, while also
+	 * gathering the orbit's features. Smooth values follow data.smoothing,
+	 * and the whole orbit is iterated even inside the main cardioid, as its
+	 * features are needed there too.*/
+	FractalCoordsInfo calculate_features(
+		COMPLEX coords,
+		const OrbitFeatureSettings& settings,
+		OrbitFeatures& features);
+
+	/**Calculates the Mandelbrot fractal like calculate, continuing the
+	 * orbit from state and leaving it where the iterations ran out. States
+	 * iterated past data.iters are started over. The exponential smoothing
+	 * sum is always accumulated, so the state serves every SmoothingMode.
+	 * Resumed orbits may find cycles at other iterations than calculate,
+	 * within the period tolerance.*/
+	FractalCoordsInfo calculate_resume(COMPLEX coords, OrbitState& state);
+
+	/**calculate_resume for a batch of pixels, with each pixel's state in
+	 * states. Orbits with iterations left are continued by the vectorized
+	 * engine when the CPU and exponent allow it, in double precision.*/
+	void calculate_resume_batch(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		OrbitState* states,
+		const FractalBatchInfo& results);
+
+	/**Calculates the Mandelbrot fractal like calculate, iterating in
+	 * double-double precision for views too deep for fpreal64. Fractional
+	 * exponents fall back to calculate.*/
+	FractalCoordsInfo calculate_dd(const ComplexDD& coords);
+
+	/**Calculates a contiguous batch of coordinates with the vectorized
+	 * engine from MandelbrotSIMD.h, writing the same values calculate would.
+	 * The smooth sum is skipped when smooth is null, and the final z values
+	 * are only written when z_real and z_imag are given.
+	 * Precision::SINGLE iterates twice as many pixels at a time, and only
+	 * matches calculate as closely as single precision allows.
+	 * Returns false without writing anything if the CPU, the exponent or
+	 * the precision is not supported by the engine, in which case calculate
+	 * must be used.*/
+	bool calculate_simd(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		int* num_iter,
+		fpreal64* smooth,
+		fpreal64* z_real = nullptr,
+		fpreal64* z_imag = nullptr,
+		Precision precision = Precision::DOUBLE);
+
+protected:
+	/**Exponent of the kernel selected from data.power when constructed.
+	 * 0 selects the generic std::pow kernel.*/
+	int kernel_power{ 2 };
+
+	/**Whether the main cardioid and period-2 bulb are blackholed without
+	 * iterating, leaving their z at 0. calculate_features doesn't skip
+	 * them. See MandelbrotStashData::allows_interior_test.*/
+	bool interior_test{ false };
+
+	/**Logarithms of the bailout and of the per-iteration growth of |z|,
+	 * used by SmoothingMode::NORMALIZED. See normalized_iterations.*/
+	fpreal log_bailout{ 0.0 };
+	fpreal log_degree{ 0.0 };
+
+	/**Kernels specialized for data's flags, selected by select_kernels
+	 * so that calls don't test the flags again.*/
+	typedef FractalCoordsInfo(Mandelbrot::*PointKernel)(COMPLEX coords);
+	typedef FractalCoordsInfo(Mandelbrot::*DDKernel)(const ComplexDD& c);
+	typedef COMPLEX(Mandelbrot::*ZKernel)(COMPLEX z, COMPLEX c);
+	typedef COMPLEX(Mandelbrot::*DZKernel)(COMPLEX z, COMPLEX c, COMPLEX& dz);
+	typedef FractalCoordsInfo(Mandelbrot::*FeatureKernel)(COMPLEX coords,
+		const OrbitFeatureSettings& settings, OrbitFeatures& features);
+	typedef FractalCoordsInfo(Mandelbrot::*ResumeKernel)(COMPLEX coords,
+		OrbitState& state);
+	typedef void(Mandelbrot::*BatchKernel)(const fpreal64* real,
+		const fpreal64* imag, exint size, const FractalBatchInfo& results);
+
+	PointKernel point_kernel{ nullptr };
+	PointKernel distance_kernel{ nullptr };
+	DDKernel dd_kernel{ nullptr };
+	ZKernel z_kernel{ nullptr };
+	DZKernel dz_kernel{ nullptr };
+	FeatureKernel feature_kernel{ nullptr };
+	ResumeKernel resume_kernel{ nullptr };
+	BatchKernel batch_kernel{ nullptr };
+
+	/**Derives the kernel settings from data, and selects the kernels. Called
+	 * by the constructors, which run once per cook in newContextData.*/
+	void configure();
+
+	/**Fills the kernel pointers with the specializations for data.*/
+	void select_kernels();
+
+	template <int N>
+	void select_kernels_for_power();
+
+	template <int N, int J>
+	void select_kernels_for_julia();
+
+	template <int N, int J, bool Blackhole>
+	void select_point_kernels();
+
+	/**Sets point_kernel and batch_kernel to the specializations for
+	 * Smoothing.*/
+	template <int N, int J, bool Blackhole, SmoothingMode Smoothing>
+	void set_point_kernels();
+
+	/**calculate_z specialized for the exponent N and the Julia depth J.
+	 * See kernel_pow and KERNEL_JULIA_ANY.*/
+	template <int N, int J>
+	COMPLEX calculate_z_kernel(COMPLEX z, COMPLEX c);
+
+	/**calculate_z with dz/dc, specialized as calculate_z_kernel.*/
+	template <int N, int J>
+	COMPLEX calculate_z_kernel(COMPLEX z, COMPLEX c, COMPLEX& dz);
+
+	/**calculate specialized for the exponent N, the Julia depth J, and
+	 * data's blackhole and smoothing. When Distance is set, dz/dc is tracked
+	 * for the distance estimate.*/
+	template <int N, int J, bool Blackhole, SmoothingMode Smoothing,
+		bool Distance>
+	FractalCoordsInfo calculate_kernel(COMPLEX coords);
+
+	/**calculate_batch without the vectorized engine, looping over
+	 * calculate_kernel so that the kernel is inlined into the loop rather
+	 * than called through point_kernel for every pixel.*/
+	template <int N, int J, bool Blackhole, SmoothingMode Smoothing>
+	void calculate_batch_kernel(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		const FractalBatchInfo& results);
+
+	/**calculate_features specialized as calculate_kernel.*/
+	template <int N, int J, bool Blackhole>
+	FractalCoordsInfo calculate_features_kernel(
+		COMPLEX coords,
+		const OrbitFeatureSettings& settings,
+		OrbitFeatures& features);
+
+	/**Starts over the orbits of state that can't be resumed, and starts
+	 * unstarted orbits, as calculate_resume does before iterating.*/
+	void start_resume(COMPLEX c, OrbitState& state) const;
+
+	/**Returns the results of a resumed orbit, once it has been iterated.*/
+	FractalCoordsInfo finish_resume(const OrbitState& state) const;
+
+	/**calculate_resume specialized as calculate_kernel.*/
+	template <int N, int J, bool Blackhole>
+	FractalCoordsInfo calculate_resume_kernel(
+		COMPLEX coords,
+		OrbitState& state);
+
+	/**calculate_dd specialized for the exponent N.*/
+	template <int N>
+	FractalCoordsInfo calculate_kernel_dd(const ComplexDD& c);
+
+	/**Keeps iterating an escaped orbit until its distance estimate
+	 * settles, and returns the estimate. Estimates already beyond
+	 * distance_cutoff are returned without iterating.*/
+	template <int N, int J>
+	fpreal settle_distance(COMPLEX z, COMPLEX c, COMPLEX dz);
 };
 
 /**Class that implements the 'Pickover Stalk' fractal. In fractal terms, it
@@ -57,11 +405,19 @@ public:
 	 * related object. */
 	PickoverStashData data;
 
-	Pickover() = default;
+	Pickover();
 	Pickover(PickoverStashData& pickoverData);
 
 	virtual FractalCoordsInfo calculate(COMPLEX coords);
 
+	/**Calculates a batch with the exponent's kernel, writing the minimum
+	 * distances as the smooth values.*/
+	virtual void calculate_batch(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		const FractalBatchInfo& results) override;
+
 	/** Z is the current iteration in a recursive fractal calculation,
 	 * and point is a reference point. */
 	fpreal distance_to_point(COMPLEX z, COMPLEX point);
@@ -70,5 +426,41 @@ public:
 	 * offset is a translation that will be applied to the line, and theta
 	 * is a number of degrees to rotate the line.*/
 	fpreal distance_to_line(COMPLEX z, COMPLEX offset, fpreal theta);
+
+protected:
+	/**Kernels specialized for data's flags. See Mandelbrot::select_kernels.*/
+	typedef FractalCoordsInfo(Pickover::*PickoverKernel)(COMPLEX coords);
+	typedef void(Pickover::*PickoverBatchKernel)(const fpreal64* real,
+		const fpreal64* imag, exint size, const FractalBatchInfo& results);
+	PickoverKernel pickover_kernel{ nullptr };
+	PickoverBatchKernel pickover_batch_kernel{ nullptr };
+
+	/**Fills the pickover kernels with the specializations for data.*/
+	void select_pickover_kernel();
+
+	template <int N>
+	void select_pickover_kernel_for_power();
+
+	template <int N, int J>
+	void select_pickover_kernel_for_julia();
+
+	/**calculate specialized for the exponent N, the Julia depth J, whether
+	 * distances are measured to a Line or a point, and Blackhole.*/
+	template <int N, int J, bool Line, bool Blackhole>
+	FractalCoordsInfo calculate_kernel(COMPLEX coords);
+
+	/**calculate_batch looping over calculate_kernel, so that the kernel is
+	 * inlined into the loop.*/
+	template <int N, int J, bool Line, bool Blackhole>
+	void calculate_batch_kernel(
+		const fpreal64* real,
+		const fpreal64* imag,
+		exint size,
+		const FractalBatchInfo& results);
+
+	/**Sets the pickover kernels to the specializations for Line and
+	 * Blackhole.*/
+	template <int N, int J, bool Line, bool Blackhole>
+	void set_pickover_kernels();
 };
 }
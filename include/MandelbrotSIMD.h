@@ -0,0 +1,120 @@
+/** \file MandelbrotSIMD.h
+	Header declaring the vectorized batch Mandelbrot engine.
+
+ * The engine calculates many pixels per instruction by storing the real and
+ * imaginary parts of a batch in structure-of-arrays form. Each vector lane
+ * holds one pixel, and when a lane escapes (or reaches the iteration limit)
+ * it is immediately refilled with the next pixel in the batch, so pixels with
+ * very different escape times don't leave the vector units idle.
+ *
+ * The instruction set is picked at runtime, so a single DSO runs on every
+ * machine. Each instruction set lives in its own source file, compiled with
+ * only that instruction set enabled.
+ */
+
+#pragma once
+
+// HDK
+#include <SYS/SYS_Types.h>
+
+namespace CC
+{
+/**Returns whether c = (x, y) lies inside the main cardioid or the period-2
+ * bulb of the canonical Mandelbrot set, whose points never escape. Only
+ * meaningful when MandelbrotStashData::allows_interior_test is true.
+ * This is static so the scalar kernels, and the sources compiled for wider
+ * instruction sets, each get their own copy.*/
+static inline bool
+in_cardioid_or_bulb(fpreal64 x, fpreal64 y)
+{
+	fpreal64 y_sq = y * y;
+
+	// Main cardioid: q * (q + (x - 1/4)) <= y^2 / 4
+	fpreal64 x_shift = x - 0.25;
+	fpreal64 q = x_shift * x_shift + y_sq;
+	if (q * (q + x_shift) <= 0.25 * y_sq)
+		return true;
+
+	// Period-2 bulb: a disk of radius 1/4 centered on -1.
+	fpreal64 x_bulb = x + 1.0;
+	return x_bulb * x_bulb + y_sq <= 0.0625;
+}
+
+/**Vector instruction sets the batch Mandelbrot engine can run with.*/
+enum class SIMDInstructionSet
+{
+	SCALAR, /**No supported instruction set. Callers fall back to scalar.*/
+	AVX2, /**4 double precision lanes.*/
+	AVX512 /**8 double precision lanes.*/
+};
+
+/**Returns the widest instruction set supported by both the CPU and the OS.
+ * This is detected on the first call and cached afterwards.*/
+SIMDInstructionSet get_simd_instruction_set();
+
+/**Plain description of a batch of Mandelbrot pixels, and the arrays the
+ * results are written to. Only plain types are used here, because this is
+ * shared with the sources compiled for specific instruction sets.*/
+struct MandelbrotBatch
+{
+	/**Real and imaginary parts of the coordinates, 'size' values long.*/
+	const fpreal64* real{ nullptr };
+	const fpreal64* imag{ nullptr };
+	exint size{ 0 };
+
+	/**Fractal parameters. See MandelbrotStashData. power must be a whole
+	 * exponent between 2 and MAX_KERNEL_POWER.*/
+	int power{ 2 };
+	int iters{ 50 };
+	fpreal64 bailout{ 2 };
+	int jdepth{ 0 };
+	fpreal64 joffset_real{ 0 };
+	fpreal64 joffset_imag{ 0 };
+	bool blackhole{ false };
+
+	/**Whether pixels inside the main cardioid and period-2 bulb are
+	 * blackholed without iterating. See in_cardioid_or_bulb.*/
+	bool interior_test{ false };
+
+	/**Whether orbits returning to a checkpoint within periodtol are
+	 * blackholed early. Only valid with blackhole enabled.*/
+	bool periodicity{ false };
+	fpreal64 periodtol{ 0 };
+
+	/**Whether the exponential smoothing sum is accumulated.*/
+	bool smooth{ true };
+
+	/**Whether lanes are iterated in single precision, fitting twice as
+	 * many in a vector. Results then differ from the scalar kernels.*/
+	bool single{ false };
+
+	/**Output arrays, 'size' values long. The z arrays may be null, and
+	 * hold 0 for pixels the interior test blackholes.*/
+	int* num_iter{ nullptr };
+	fpreal64* smooth_values{ nullptr };
+	fpreal64* z_real{ nullptr };
+	fpreal64* z_imag{ nullptr };
+
+	/**Optional orbit states to resume from, 'size' values long, such as
+	 * an OrbitState's. Each pixel continues from z after start_iters
+	 * bounded iterations, with start_smooth as its smoothing sum, and takes
+	 * its first checkpoint there. Null starts every orbit at 0. Resumed
+	 * pixels must have iterations left, and interior_test is ignored.*/
+	const fpreal64* start_real{ nullptr };
+	const fpreal64* start_imag{ nullptr };
+	const fpreal64* start_smooth{ nullptr };
+	const int* start_iters{ nullptr };
+
+	/**Optional output, 'size' values long, set for the pixels whose orbit
+	 * was found periodic.*/
+	bool* periodic{ nullptr };
+};
+
+/**Calculates a batch with 4-wide AVX2 vectors. Only call this when
+ * get_simd_instruction_set reports AVX2 or better.*/
+void calculate_mandelbrot_avx2(const MandelbrotBatch& batch);
+
+/**Calculates a batch with 8-wide AVX-512 vectors. Only call this when
+ * get_simd_instruction_set reports AVX512.*/
+void calculate_mandelbrot_avx512(const MandelbrotBatch& batch);
+}  // End of CC Namespace
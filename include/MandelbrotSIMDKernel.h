@@ -0,0 +1,315 @@
+/** \file MandelbrotSIMDKernel.h
+	Header-only batch Mandelbrot engine, generic over a vector traits type.
+
+ * This is only included by the per-instruction-set sources, which provide
+ * a traits struct wrapping their intrinsics. Those sources are compiled with
+ * their instruction set enabled, so nothing is included here that could share
+ * inline code with the rest of the plugin.
+ *
+ * The arithmetic mirrors Mandelbrot::calculate_kernel operation for
+ * operation, and is never contracted into fused multiply-adds, so iteration
+ * counts and final z values of double precision traits are identical to the
+ * scalar kernels. Single precision traits (scalar type S of float) iterate
+ * twice the lanes, and are only used when the node's Precision is set to
+ * Single.
+ */
+
+#pragma once
+
+ // Local
+#include "MandelbrotSIMD.h"
+
+namespace CC
+{
+namespace simd
+{
+/**Vector form of ipow from Mandelbrot.h, raising every lane of z to the
+ * compile time exponent N by repeated squaring.*/
+template <typename T, int N>
+struct VectorPow
+{
+	typedef typename T::V V;
+
+	static inline void
+	apply(V zr, V zi, V& out_r, V& out_i)
+	{
+		V hr, hi;
+		VectorPow<T, N / 2>::apply(zr, zi, hr, hi);
+
+		// Same operation order as complex_mult, so results match bit for bit.
+		V sr = T::sub(T::mul(hr, hr), T::mul(hi, hi));
+		V si = T::add(T::mul(hr, hi), T::mul(hi, hr));
+
+		if (N % 2)
+		{
+			out_r = T::sub(T::mul(sr, zr), T::mul(si, zi));
+			out_i = T::add(T::mul(sr, zi), T::mul(si, zr));
+		}
+		else
+		{
+			out_r = sr;
+			out_i = si;
+		}
+	}
+};
+
+template <typename T>
+struct VectorPow<T, 1>
+{
+	typedef typename T::V V;
+
+	static inline void
+	apply(V zr, V zi, V& out_r, V& out_i)
+	{
+		out_r = zr;
+		out_i = zi;
+	}
+};
+
+/**Returns exp(x) for every lane where x <= 0. This is the Cephes
+ * range-reduced Pade approximation, accurate to about one ulp, which is far
+ * finer than the single precision the COPs store.*/
+template <typename T>
+inline typename T::V
+exp_negative(typename T::V x)
+{
+	typedef typename T::V V;
+
+	// Below this exp underflows, and contributes nothing to a smooth sum.
+	x = T::max(x, T::set1(T::exp_min()));
+
+	// x = n * ln(2) + r, where |r| <= ln(2) / 2
+	V n = T::round(T::mul(x, T::set1(1.4426950408889634073599)));
+	x = T::sub(x, T::mul(n, T::set1(6.93145751953125e-1)));
+	x = T::sub(x, T::mul(n, T::set1(1.42860682030941723212e-6)));
+
+	V xx = T::mul(x, x);
+	V px = T::add(T::mul(T::set1(1.26177193074810590878e-4), xx),
+		T::set1(3.02994407707441961300e-2));
+	px = T::mul(x, T::add(T::mul(px, xx),
+		T::set1(9.99999999999999999910e-1)));
+
+	V qx = T::add(T::mul(T::set1(3.00198505138664455042e-6), xx),
+		T::set1(2.52448340349684104192e-3));
+	qx = T::add(T::mul(qx, xx), T::set1(2.27265548208155028766e-1));
+	qx = T::add(T::mul(qx, xx), T::set1(2.00000000000000000009e0));
+
+	x = T::div(px, T::sub(qx, px));
+	x = T::add(T::set1(1.0), T::add(x, x));
+
+	return T::mul(x, T::pow2n(n));
+}
+
+/**Calculates every pixel of the batch with the exponent N. Lanes are
+ * refilled from the batch as soon as their pixel finishes, and the lane
+ * state is only spilled to memory when at least one lane has finished.*/
+template <typename T, int N>
+void
+calculate_batch(const MandelbrotBatch& batch)
+{
+	typedef typename T::S S;
+	typedef typename T::V V;
+	typedef typename T::M M;
+	const int width = T::WIDTH;
+
+	// Lane state, in memory while lanes are being written and refilled.
+	alignas(64) S zr[width], zi[width];
+	alignas(64) S cr[width], ci[width];
+	alignas(64) S smooth[width], iters[width];
+	alignas(64) S checkr[width], checki[width], refresh[width];
+	exint pixel[width];
+
+	exint next{ 0 };
+	int active{ 0 }; // Bitmask of the lanes currently holding a pixel.
+
+	// Starts the next pixel in the queue on a lane, or parks the lane.
+	auto fill_lane = [&](int lane)
+	{
+		zr[lane] = zi[lane] = 0.0;
+		iters[lane] = 0.0;
+		smooth[lane] = 1.0;  // exp(-abs(0)), the scalar initial value.
+		checkr[lane] = checki[lane] = 0.0;
+		refresh[lane] = 1.0;
+
+		// Pixels known to be inside the set are written without iterating.
+		while (batch.interior_test && !batch.start_iters &&
+			next < batch.size &&
+			in_cardioid_or_bulb(batch.real[next], batch.imag[next]))
+		{
+			batch.num_iter[next] = -1;
+			if (batch.smooth_values)
+				batch.smooth_values[next] = -1.0;
+			if (batch.z_real)
+				batch.z_real[next] = 0.0;
+			if (batch.z_imag)
+				batch.z_imag[next] = 0.0;
+			++next;
+		}
+
+		if (next < batch.size)
+		{
+			pixel[lane] = next;
+			cr[lane] = static_cast<S>(batch.real[next]);
+			ci[lane] = static_cast<S>(batch.imag[next]);
+
+			// Resumed orbits refresh their checkpoint at the powers of two
+			// past their iterations, as in Mandelbrot::calculate_resume.
+			if (batch.start_iters)
+			{
+				zr[lane] = checkr[lane] = static_cast<S>(batch.start_real[next]);
+				zi[lane] = checki[lane] = static_cast<S>(batch.start_imag[next]);
+				iters[lane] = static_cast<S>(batch.start_iters[next]);
+				smooth[lane] = static_cast<S>(batch.start_smooth[next]);
+				while (refresh[lane] <= iters[lane])
+					refresh[lane] *= 2.0;
+			}
+
+			active |= 1 << lane;
+			++next;
+		}
+		else
+		{
+			pixel[lane] = -1;
+			cr[lane] = ci[lane] = 0.0;
+			active &= ~(1 << lane);
+		}
+	};
+
+	for (int lane = 0; lane < width; ++lane)
+		fill_lane(lane);
+
+	const V bailout_sq = T::set1(batch.bailout * batch.bailout);
+	const V max_iters = T::set1(batch.iters);
+	const V jr = T::set1(batch.joffset_real);
+	const V ji = T::set1(batch.joffset_imag);
+	const V period_tol_sq = T::set1(batch.periodtol * batch.periodtol);
+	const V one = T::set1(1.0);
+	const V zero = T::set1(0.0);
+
+	V Zr = T::load(zr), Zi = T::load(zi);
+	V Cr = T::load(cr), Ci = T::load(ci);
+	V Smooth = T::load(smooth), Iters = T::load(iters);
+	V Checkr = T::load(checkr), Checki = T::load(checki);
+	V Refresh = T::load(refresh);
+	V Pr, Pi;
+
+	while (active)
+	{
+		// z = z^pow + c, followed by the Julia iterations.
+		VectorPow<T, N>::apply(Zr, Zi, Pr, Pi);
+		Zr = T::add(Pr, Cr);
+		Zi = T::add(Pi, Ci);
+
+		for (int julia = 0; julia < batch.jdepth; julia++)
+		{
+			VectorPow<T, N>::apply(Zr, Zi, Pr, Pi);
+			Zr = T::add(Pr, jr);
+			Zi = T::add(Pi, ji);
+		}
+
+		V norm = T::add(T::mul(Zr, Zr), T::mul(Zi, Zi));
+
+		if (batch.smooth)
+			Smooth = T::add(Smooth,
+				exp_negative<T>(T::sub(zero, T::sqrt(norm))));
+
+		// Escaped lanes keep their count, all others advance by one.
+		M escaped = T::cmpgt(norm, bailout_sq);
+		Iters = T::add_unless(Iters, one, escaped);
+
+		int escaped_bits = T::bits(escaped);
+		int done_bits = escaped_bits | T::bits(T::cmpeq(Iters, max_iters));
+
+		// Brent's cycle detection, as in Mandelbrot::calculate_kernel.
+		int periodic_bits{ 0 };
+		if (batch.periodicity)
+		{
+			V dr = T::sub(Zr, Checkr);
+			V di = T::sub(Zi, Checki);
+			V dist = T::add(T::mul(dr, dr), T::mul(di, di));
+			periodic_bits =
+				T::bits(T::cmpgt(period_tol_sq, dist)) & ~escaped_bits;
+			done_bits |= periodic_bits;
+
+			M move = T::cmpeq(Iters, Refresh);
+			Checkr = T::blend(Checkr, Zr, move);
+			Checki = T::blend(Checki, Zi, move);
+			Refresh = T::blend(Refresh, T::add(Refresh, Refresh), move);
+		}
+
+		done_bits &= active;
+
+		if (!done_bits)
+			continue;
+
+		// Write out the finished lanes, and refill them from the queue.
+		T::store(zr, Zr);
+		T::store(zi, Zi);
+		T::store(smooth, Smooth);
+		T::store(iters, Iters);
+		T::store(checkr, Checkr);
+		T::store(checki, Checki);
+		T::store(refresh, Refresh);
+
+		for (int lane = 0; lane < width; ++lane)
+		{
+			if (!(done_bits & (1 << lane)))
+				continue;
+
+			exint i = pixel[lane];
+			int num_iter = static_cast<int>(iters[lane]);
+			fpreal64 smoothcolor = smooth[lane];
+
+			// Blackhole lanes that reached the limit without escaping, or
+			// were found to be periodic.
+			if (batch.blackhole && !(escaped_bits & (1 << lane)) &&
+				(num_iter == batch.iters || (periodic_bits & (1 << lane))))
+			{
+				num_iter = -1;
+				smoothcolor = -1.0;
+			}
+
+			batch.num_iter[i] = num_iter;
+			if (batch.smooth_values)
+				batch.smooth_values[i] = smoothcolor;
+			if (batch.z_real)
+				batch.z_real[i] = zr[lane];
+			if (batch.z_imag)
+				batch.z_imag[i] = zi[lane];
+			if (batch.periodic)
+				batch.periodic[i] = (periodic_bits & (1 << lane)) != 0;
+
+			fill_lane(lane);
+		}
+
+		Zr = T::load(zr);
+		Zi = T::load(zi);
+		Cr = T::load(cr);
+		Ci = T::load(ci);
+		Smooth = T::load(smooth);
+		Iters = T::load(iters);
+		Checkr = T::load(checkr);
+		Checki = T::load(checki);
+		Refresh = T::load(refresh);
+	}
+}
+
+/**Calculates the batch with the kernel matching batch.power.*/
+template <typename T>
+void
+calculate_batch(const MandelbrotBatch& batch)
+{
+	switch (batch.power)
+	{
+	case 2: calculate_batch<T, 2>(batch); break;
+	case 3: calculate_batch<T, 3>(batch); break;
+	case 4: calculate_batch<T, 4>(batch); break;
+	case 5: calculate_batch<T, 5>(batch); break;
+	case 6: calculate_batch<T, 6>(batch); break;
+	case 7: calculate_batch<T, 7>(batch); break;
+	case 8: calculate_batch<T, 8>(batch); break;
+	default: break;
+	}
+}
+}  // End of simd Namespace
+}  // End of CC Namespace
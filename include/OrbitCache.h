@@ -0,0 +1,82 @@
+/** \file OrbitCache.h
+	Header declaring the cache of per-pixel orbit state kept between cooks.
+
+ * Each pixel's OrbitState is stored by tile, so that cooks which only
+ * change how values are shaded, or which raise the iterations, continue
+ * from the previous cook's orbits instead of starting over from z = 0.
+ * The cache is keyed by every input that changes an orbit besides the
+ * iterations. A cook with a different key empties it.
+ */
+
+#pragma once
+
+ // Local
+#include "FractalSpace.h"
+#include "Mandelbrot.h"
+#include "StashData.h"
+
+// STL
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// HDK
+#include <UT/UT_Lock.h>
+
+namespace CC
+{
+/**Inputs that change the orbit of a pixel, other than the iterations.*/
+struct OrbitCacheKey
+{
+	fpreal power{ 2.0 };
+	fpreal bailout{ 2.0 };
+	int jdepth{ 0 };
+	COMPLEX joffset;
+	bool blackhole{ false };
+	bool periodicity{ true };
+	fpreal periodtol{ 0.0 };
+
+	/**Fractal coordinates of the first pixel, and the steps between
+	 * neighbouring pixels, which fix every pixel's coordinates.*/
+	COMPLEX origin;
+	COMPLEX step_x;
+	COMPLEX step_y;
+
+	OrbitCacheKey() = default;
+	OrbitCacheKey(const MandelbrotStashData& data, const FractalSpace& space);
+
+	bool operator==(const OrbitCacheKey& other) const;
+	bool operator!=(const OrbitCacheKey& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+/**Orbit states of a tile's pixels, in tile order. The lock is held while
+ * the tile's orbits are iterated.*/
+struct OrbitCacheTile
+{
+	UT_Lock lock;
+	std::vector<OrbitState> states;
+};
+
+/**Orbit states of every cooked tile, by the tile's lower left pixel.*/
+class OrbitCache
+{
+	OrbitCacheKey key;
+	std::map<std::pair<int, int>, std::shared_ptr<OrbitCacheTile>> tiles;
+	UT_Lock lock;
+
+public:
+	/**Empties the cache if it was filled with another key.*/
+	void set_key(const OrbitCacheKey& key);
+
+	/**Returns the states of the tile at x, y, with size pixels. Tiles that
+	 * weren't cached, or changed size, return unstarted states.*/
+	std::shared_ptr<OrbitCacheTile> get_tile(int x, int y, exint size);
+
+	/**Frees every tile.*/
+	void clear();
+};
+}  // End of CC Namespace
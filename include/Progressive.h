@@ -0,0 +1,306 @@
+/** \file Progressive.h
+	Header declaring the coarse to fine cooking of generator tiles.
+
+ * A progressive tile is calculated in passes. The first pass calculates
+ * every PROGRESSIVE_MAX_STRIDE-th pixel in both axes, and each following
+ * pass halves the stride, calculating only the pixels the earlier passes
+ * didn't. Pixels not calculated yet show the sample at the corner of their
+ * stride cell. Passes stop once the cook's CookDeadline expires, and at
+ * least one pass is calculated per cook.
+ *
+ * Only interactive cooks are progressive. A tile that stopped early is
+ * kept in a ProgressiveCache, and the node is recooked once the viewer is
+ * idle, continuing the tile from its last pass. The recook also replaces
+ * the coarse tiles Houdini cached, so they're never the final image.
+ *
+ * Every pixel is calculated exactly as in a regular cook, so a tile whose
+ * last pass was reached is identical to a regular cook's.
+ */
+
+#pragma once
+
+ // Local
+#include "typedefs.h"
+
+// STL
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+// HDK
+#include <UT/UT_Lock.h>
+
+class OP_Node;
+class TIL_Tile;
+class TIL_TileList;
+
+namespace CC
+{
+class Fractal;
+class FractalSpace;
+struct AntialiasStashData;
+
+/**Pixels between the samples of the first pass. A power of two.*/
+static const int PROGRESSIVE_MAX_STRIDE{ 8 };
+
+/**Time at which a cook stops refining its tiles. Deadlines constructed
+ * without a budget never expire.*/
+class CookDeadline
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Clock::time_point end;
+	bool limited{ false };
+
+public:
+	CookDeadline() = default;
+
+	/**Expires budget milliseconds from now. A budget of 0 never expires.*/
+	explicit CookDeadline(fpreal budget) : limited(budget > 0.0)
+	{
+		end = Clock::now() + std::chrono::microseconds(
+			static_cast<std::chrono::microseconds::rep>(budget * 1000.0));
+	}
+
+	bool expired() const
+	{
+		return limited && Clock::now() >= end;
+	}
+};
+
+/**Refinement of a progressive tile. sources holds for each pixel the index
+ * of the calculated pixel it shows, see splat_tile, and stride is the
+ * stride of the last pass calculated, or 0 before the first.*/
+struct ProgressiveState
+{
+	int stride{ 0 };
+	std::vector<exint> sources;
+};
+
+/**Calculates a tile of size_x by size_y pixels coarse to fine, from the
+ * pass after state's until the deadline expires. Calculate is called with
+ * batches of tile pixel indices, and state is updated to the last pass.
+ * Returns whether every pixel was calculated.*/
+template <typename Calculate>
+bool
+progressive_tile(
+	int size_x,
+	int size_y,
+	const CookDeadline& deadline,
+	ProgressiveState& state,
+	Calculate& calculate)
+{
+	std::vector<exint> batch;
+	std::vector<exint>& sources = state.sources;
+	exint num_pixels = static_cast<exint>(size_x) * size_y;
+
+	if (state.stride <= 0 || static_cast<exint>(sources.size()) != num_pixels)
+	{
+		state.stride = 0;
+		sources.assign(num_pixels, -1);
+	}
+
+	int first = state.stride > 0 ? state.stride / 2 : PROGRESSIVE_MAX_STRIDE;
+	for (int stride = first; stride >= 1; stride /= 2)
+	{
+		if (stride < first && deadline.expired())
+			return false;
+
+		batch.clear();
+		for (int y = 0; y < size_y; y += stride)
+		{
+			for (int x = 0; x < size_x; x += stride)
+			{
+				exint i = static_cast<exint>(y) * size_x + x;
+				if (sources[i] != i)
+				{
+					sources[i] = i;
+					batch.push_back(i);
+				}
+			}
+		}
+
+		if (!batch.empty())
+			calculate(batch);
+
+		// Point every pixel not calculated yet at its cell's corner.
+		for (int y = 0; y < size_y; y++)
+		{
+			for (int x = 0; x < size_x; x++)
+			{
+				exint i = static_cast<exint>(y) * size_x + x;
+				if (sources[i] != i)
+					sources[i] = static_cast<exint>(y - y % stride) * size_x +
+						(x - x % stride);
+			}
+		}
+
+		state.stride = stride;
+	}
+
+	return true;
+}
+
+/**Identifies the cooks of a node that calculate the same pixels: its
+ * parameters haven't changed since, and the time and resolution match.*/
+struct ProgressiveKey
+{
+	int version{ -1 };
+	fpreal time{ 0.0 };
+	int size_x{ 0 };
+	int size_y{ 0 };
+
+	ProgressiveKey() = default;
+	ProgressiveKey(OP_Node* node, fpreal t, int size_x, int size_y);
+
+	bool operator==(const ProgressiveKey& other) const
+	{
+		return version == other.version && time == other.time &&
+			size_x == other.size_x && size_y == other.size_y;
+	}
+	bool operator!=(const ProgressiveKey& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+/**Tiles that stopped refining, by the tile's lower left pixel, so the next
+ * cook with the same key continues them. Samples holds whatever the node
+ * calculates per pixel.*/
+template <typename Samples>
+class ProgressiveCache
+{
+public:
+	/**A kept tile. The lock is held while the tile is refined.*/
+	struct Tile
+	{
+		UT_Lock lock;
+		ProgressiveState state;
+		Samples samples;
+	};
+
+	/**Empties the cache if it was filled with another key.*/
+	void set_key(const ProgressiveKey& new_key)
+	{
+		UT_AutoLock lock_tiles(lock);
+		if (new_key != key)
+		{
+			tiles.clear();
+			key = new_key;
+		}
+	}
+
+	/**Returns the tile at x, y, unstarted if it wasn't kept.*/
+	std::shared_ptr<Tile> get_tile(int x, int y)
+	{
+		UT_AutoLock lock_tiles(lock);
+		std::shared_ptr<Tile>& tile = tiles[std::make_pair(x, y)];
+		if (!tile)
+			tile = std::make_shared<Tile>();
+		return tile;
+	}
+
+	/**Stops keeping the tile at x, y, once it is fully refined.*/
+	void release_tile(int x, int y)
+	{
+		UT_AutoLock lock_tiles(lock);
+		tiles.erase(std::make_pair(x, y));
+	}
+
+	/**Frees every tile.*/
+	void clear()
+	{
+		UT_AutoLock lock_tiles(lock);
+		tiles.clear();
+		key = ProgressiveKey();
+	}
+
+private:
+	ProgressiveKey key;
+	std::map<std::pair<int, int>, std::shared_ptr<Tile>> tiles;
+	UT_Lock lock;
+};
+
+/**Recooks node from the UI event loop once its cook has returned, refining
+ * the tiles it kept. Safe to call from tile threads. Only the first call of
+ * a cook schedules, see scheduled.*/
+void schedule_refinement(OP_Node* node, std::atomic<bool>& scheduled);
+
+/**Copies the value of each pixel's source over the pixels that weren't
+ * calculated by progressive_tile.*/
+template <typename T>
+void
+splat_tile(T* values, const std::vector<exint>& sources)
+{
+	for (exint i = 0; i < static_cast<exint>(sources.size()); i++)
+		if (sources[i] != i)
+			values[i] = values[sources[i]];
+}
+
+template <typename T>
+void
+splat_tile(std::vector<T>& values, const std::vector<exint>& sources)
+{
+	splat_tile(values.data(), sources);
+}
+
+/**Refines the tile whose lower left pixel is tile_x, tile_y coarse to fine
+ * until deadline, with progressive_tile. Samples holds the tile's results,
+ * which calculate writes. They're restored from the samples cache kept by
+ * earlier cooks, kept again while the tile isn't complete, and splatted
+ * with splat_tile. Node is scheduled for refinement while the tile isn't
+ * complete. Returns whether every pixel has its own sample.*/
+template <typename Samples, typename Calculate>
+bool
+refine_progressive_tile(
+	OP_Node* node,
+	std::atomic<bool>& scheduled,
+	const CookDeadline& deadline,
+	ProgressiveCache<Samples>& cache,
+	int tile_x,
+	int tile_y,
+	int size_x,
+	int size_y,
+	Samples& samples,
+	Calculate& calculate)
+{
+	std::shared_ptr<typename ProgressiveCache<Samples>::Tile> kept =
+		cache.get_tile(tile_x, tile_y);
+	UT_AutoLock lock_kept(kept->lock);
+
+	if (kept->state.stride > 0)
+		samples = kept->samples;
+
+	bool complete = progressive_tile(
+		size_x, size_y, deadline, kept->state, calculate);
+
+	if (complete)
+		cache.release_tile(tile_x, tile_y);
+	else
+	{
+		kept->samples = samples;
+		schedule_refinement(node, scheduled);
+	}
+
+	splat_tile(samples, kept->state.sources);
+	return complete;
+}
+
+/**Calculates a tile of a fractal with a single smooth value per pixel, as
+ * Pickover and Lyapunov shade, into dest. The tile is refined with
+ * refine_progressive_tile when progressive isn't null, or calculated a row
+ * at a time otherwise, and antialiased once complete.*/
+void calculate_smooth_tile(
+	OP_Node* node,
+	Fractal& fractal,
+	const FractalSpace& space,
+	const AntialiasStashData& antialias,
+	ProgressiveCache<std::vector<fpreal32>>* progressive,
+	const CookDeadline& deadline,
+	std::atomic<bool>& refining,
+	TIL_TileList* tileList,
+	TIL_Tile* tile,
+	fpreal32* dest);
+}  // End of CC Namespace
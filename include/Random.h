@@ -0,0 +1,186 @@
+/** \file Random.h
+	Header defining the random numbers used by sampled fractals.
+
+ * Sampled fractals, such as the Buddhabrot, draw their samples in parallel.
+ * A sequential generator such as std::mt19937 would make every sample depend
+ * on how many came before it on the same thread, so instead each sample's
+ * values are a pure function of the node's seed and the sample's index.
+ * Besides independent random values, this holds for the scrambled low
+ * discrepancy sequences, which cover the unit square more evenly.
+ */
+
+#pragma once
+
+ // Local
+#include "typedefs.h"
+
+namespace CC
+{
+/**Philox4x32-10 counter-based generator, from Salmon et al. "Parallel
+ * Random Numbers: As Easy as 1, 2, 3". Ten rounds of multiplies and xors
+ * scramble a counter under a key into four random words.*/
+class Philox
+{
+	uint32 key[2];
+
+	/**Returns the high and low words of a * b.*/
+	static uint32 mulhilo(uint32 a, uint32 b, uint32& hi)
+	{
+		uint64 product = static_cast<uint64>(a) * b;
+		hi = static_cast<uint32>(product >> 32);
+		return static_cast<uint32>(product);
+	}
+
+public:
+	explicit Philox(uint64 seed)
+	{
+		key[0] = static_cast<uint32>(seed);
+		key[1] = static_cast<uint32>(seed >> 32);
+	}
+
+	/**Writes the four random words of a counter, given as the index and a
+	 * stream which separates uses of the same index.*/
+	void generate(uint64 index, uint64 stream, uint32 out[4]) const
+	{
+		uint32 ctr[4] = {
+			static_cast<uint32>(index), static_cast<uint32>(index >> 32),
+			static_cast<uint32>(stream), static_cast<uint32>(stream >> 32) };
+		uint32 k0 = key[0];
+		uint32 k1 = key[1];
+
+		for (int round = 0; round < 10; round++)
+		{
+			uint32 hi0, hi1;
+			uint32 lo0 = mulhilo(0xD2511F53u, ctr[0], hi0);
+			uint32 lo1 = mulhilo(0xCD9E8D57u, ctr[2], hi1);
+
+			ctr[0] = hi1 ^ ctr[1] ^ k0;
+			ctr[1] = lo1;
+			ctr[2] = hi0 ^ ctr[3] ^ k1;
+			ctr[3] = lo0;
+
+			// Weyl sequence bump of the key between rounds.
+			k0 += 0x9E3779B9u;
+			k1 += 0xBB67AE85u;
+		}
+
+		for (int i = 0; i < 4; i++)
+			out[i] = ctr[i];
+	}
+
+	/**Writes two values uniform in [0, 1) for a counter, each using 53 bits
+	 * of two of its words.*/
+	void uniform2(
+		uint64 index, uint64 stream, fpreal64& u, fpreal64& v) const
+	{
+		uint32 words[4];
+		generate(index, stream, words);
+		u = to_unit(words[0], words[1]);
+		v = to_unit(words[2], words[3]);
+	}
+
+	/**Returns a value uniform in [0, 1) from two random words.*/
+	static fpreal64 to_unit(uint32 a, uint32 b)
+	{
+		return ((a >> 5) * 67108864.0 + (b >> 6)) *
+			(1.0 / 9007199254740992.0);
+	}
+};
+
+/**Returns the bits of x in reverse order.*/
+inline uint32
+reverse_bits(uint32 x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/**Owen scrambles a 32 bit fraction, randomly flipping each bit based on the
+ * bits above it. This keeps the stratification of a low discrepancy
+ * sequence while jittering every point within its strata. Uses the hash of
+ * Burley, "Practical Hash-based Owen Scrambling".*/
+inline uint32
+owen_scramble(uint32 x, uint32 seed)
+{
+	x = reverse_bits(x);
+	x += seed;
+	x ^= x * 0x6C50B47Cu;
+	x ^= x * 0xB82F1E52u;
+	x ^= x * 0xC7AFE638u;
+	x ^= x * 0x8D22F6E6u;
+	return reverse_bits(x);
+}
+
+/**First two dimensions of the Sobol sequence, Owen scrambled by the seed.
+ * Any 2^k consecutive points from a multiple of 2^k fill the unit square
+ * evenly. Indices repeat past 2^32.*/
+class Sobol
+{
+	uint32 seeds[2];
+
+public:
+	explicit Sobol(uint64 seed)
+	{
+		// Scrambles are drawn from a stream Philox samples never use.
+		uint32 words[4];
+		Philox(seed).generate(0, ~uint64(0), words);
+		seeds[0] = words[0];
+		seeds[1] = words[1];
+	}
+
+	/**Writes the point of an index, in [0, 1) in both dimensions.*/
+	void sample2(uint64 index, fpreal64& u, fpreal64& v) const
+	{
+		// The first dimension is the van der Corput sequence. The second
+		// uses the direction numbers of the polynomial x + 1.
+		uint32 i = static_cast<uint32>(index);
+		uint32 x = reverse_bits(i);
+		uint32 y{ 0 };
+		for (uint32 direction = 0x80000000u; i; i >>= 1)
+		{
+			if (i & 1)
+				y ^= direction;
+			direction ^= direction >> 1;
+		}
+
+		u = owen_scramble(x, seeds[0]) * (1.0 / 4294967296.0);
+		v = owen_scramble(y, seeds[1]) * (1.0 / 4294967296.0);
+	}
+};
+
+/**Halton sequence in bases 2 and 3, with a Cranley-Patterson rotation by
+ * the seed that shifts every point by the same random offset.*/
+class Halton
+{
+	fpreal64 offsets[2];
+
+	/**Returns the digits of index in base b, mirrored about the point.*/
+	static fpreal64 radical_inverse(uint64 index, uint32 base)
+	{
+		const fpreal64 inverse = 1.0 / base;
+		fpreal64 scale = inverse;
+		fpreal64 result{ 0.0 };
+		for (; index; index /= base, scale *= inverse)
+			result += (index % base) * scale;
+		return result;
+	}
+
+public:
+	explicit Halton(uint64 seed)
+	{
+		Philox(seed).uniform2(1, ~uint64(0), offsets[0], offsets[1]);
+	}
+
+	/**Writes the point of an index, in [0, 1) in both dimensions.*/
+	void sample2(uint64 index, fpreal64& u, fpreal64& v) const
+	{
+		u = radical_inverse(index, 2) + offsets[0];
+		v = radical_inverse(index, 3) + offsets[1];
+		u -= u >= 1.0 ? 1.0 : 0.0;
+		v -= v >= 1.0 ? 1.0 : 0.0;
+	}
+};
+}  // End of CC Namespace
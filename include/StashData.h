@@ -16,6 +16,7 @@
 #include "typedefs.h"
 
 // STL
+#include <string>
 #include <vector>
 #include <initializer_list>
 
@@ -24,6 +25,29 @@
 
 namespace CC
 {
+/** Highest whole-number exponent given its own specialized fractal kernel.*/
+static const int MAX_KERNEL_POWER{ 8 };
+
+/** Largest period tolerance, as a fraction of the spacing between pixels.
+ * Escaping orbits near the set can creep along closer than a fixed
+ * tolerance on deep framings, and be mistaken for cycles.*/
+static const fpreal PERIOD_TOL_PIXELS{ 1e-6 };
+
+/** How Mandelbrot-like fractals smooth their iteration counts. */
+enum class SmoothingMode
+{
+	/** Sums exp(-|z|) over every iteration. The original look, but costs an
+	 * exp and a sqrt per iteration. */
+	EXPONENTIAL,
+
+	/** Normalized iteration count, computed once from the final |z|. */
+	NORMALIZED,
+
+	/** No smoothing, for outputs that only use iteration counts. Smooth
+	 * values are left at 0, or -1 when blackholed. */
+	NONE
+};
+
 /** Base class for stash data defining pure virtual methods. */
 class StashData
 {
@@ -71,6 +95,55 @@ struct MultiXformStashData : StashData
 	void evalArgs(const OP_Node* node, fpreal t) override;
 };
 
+/** Struct that stashes the arbitrary precision view used by deep zooms.
+ * The center and scale are stashed as strings, since past ~1e-13 they can't
+ * be represented by the double precision XformStashData values. This can be
+ * natively used with the TEMPLATES_DEEPZOOM macro from FractalNode.h.
+ */
+struct DeepZoomStashData : public StashData
+{
+	/**< Whether the deep zoom view replaces the xforms. */
+	bool enable{ false };
+
+	/**< Decimal strings of the fractal coordinates at the image center. */
+	std::string center_x{ "0" }, center_y{ "0" };
+
+	/**< Decimal string of the image width in fractal coordinates. */
+	std::string scale{ "1" };
+
+	/**< Whether leading iterations are skipped by a series approximation. */
+	bool series{ true };
+
+	void evalArgs(const OP_Node* node, fpreal t);
+};
+
+/** Struct that stashes the data of progressive cooking. See Progressive.h. */
+struct ProgressiveStashData : public StashData
+{
+	/**< Whether tiles are refined coarse to fine. Only interactive cooks
+	 * are. */
+	bool enable{ false };
+
+	/**< Milliseconds after the start of the cook refinement stops at.
+	 * 0 refines every tile fully. */
+	fpreal budget{ 0.0 };
+
+	void evalArgs(const OP_Node* node, fpreal t);
+};
+
+/** Struct that stashes the data of adaptive antialiasing. See Antialias.h. */
+struct AntialiasStashData : public StashData
+{
+	/**< Samples per axis of each supersampled pixel. 1 disables it. */
+	int samples{ 1 };
+
+	/**< Relative difference to a neighbour above which a pixel is
+	 * supersampled. */
+	fpreal threshold{ 0.1 };
+
+	void evalArgs(const OP_Node* node, fpreal t);
+};
+
 /** Struct that stashes the data required to construct a Mandelbrot Fractal. */
 struct MandelbrotStashData : public StashData
 {
@@ -92,15 +165,43 @@ struct MandelbrotStashData : public StashData
 	/**< Whether values that escape the set are colored black or not*/
 	bool blackhole{ false };
 
+	/**< Whether orbits are checked for cycles, and terminated early. */
+	bool periodicity{ true };
+
+	/**< Distance within which an orbit has returned to an earlier point. */
+	fpreal periodtol{ 1e-12 };
+
+	/**< How smooth values are calculated. Chosen by the node's output mode
+	 * rather than evaluated by evalArgs. */
+	SmoothingMode smoothing{ SmoothingMode::EXPONENTIAL };
+
 	MandelbrotStashData(
 		int iters = 50,
 		fpreal power = 2,
 		fpreal bailout = 2,
 		int jdepth = 0,
 		COMPLEX joffset = (0.0f, 0.0f),
-		bool blackhole = false);
+		bool blackhole = false,
+		bool periodicity = true,
+		fpreal periodtol = 1e-12);
 
 	void evalArgs(const OP_Node* node, fpreal t);
+
+	/** Returns the integer exponent used to select a specialized kernel,
+	 * or 0 if power is fractional or outside of 2-MAX_KERNEL_POWER and the
+	 * generic std::pow kernel must be used. */
+	int get_kernel_power() const;
+
+	/** Limits periodtol to PERIOD_TOL_PIXELS of pixel_size, the distance
+	 * between neighbouring pixels in fractal coordinates. */
+	void fit_period_tolerance(fpreal pixel_size);
+
+	/** Returns whether points inside the main cardioid and period-2 bulb
+	 * can skip straight to the blackhole result. This only holds for the
+	 * canonical z^2 + c formula without Julia iterations (so joffset is
+	 * unused), with blackhole enabled, and a bailout that no bounded orbit
+	 * can exceed. */
+	bool allows_interior_test() const;
 };
 
 /** Struct that stashes the data required to create a Pickover Fractal.
@@ -76,6 +76,36 @@ static NAMEPAIR JOFFSET_NAME{ "joffset", "Julia Offset" };
 /** Mandelbrot Fractal make escaped values black parm name */
 static NAMEPAIR BLACKHOLE_NAME{ "blackhole", "Blackhole" };
 
+/** Mandelbrot Fractal terminate periodic orbits early parm name */
+static NAMEPAIR PERIODICITY_NAME{ "periodicity", "Periodicity Checking" };
+
+/** Mandelbrot Fractal distance at which orbits are periodic parm name */
+static NAMEPAIR PERIODTOL_NAME{ "periodtol", "Period Tolerance" };
+
+/** Deep zoom toggle parm name */
+static NAMEPAIR DEEPZOOM_NAME{ "deepzoom", "Deep Zoom" };
+
+/** Deep zoom arbitrary precision view center parm name */
+static NAMEPAIR DEEPCENTER_NAME{ "deepcenter", "Deep Center" };
+
+/** Deep zoom arbitrary precision image width parm name */
+static NAMEPAIR DEEPSCALE_NAME{ "deepscale", "Deep Scale" };
+
+/** Deep zoom skip iterations with a series approximation parm name */
+static NAMEPAIR DEEPSERIES_NAME{ "deepseries", "Series Approximation" };
+
+/** Progressive coarse to fine cooking toggle parm name */
+static NAMEPAIR PROGRESSIVE_NAME{ "progressive", "Progressive" };
+
+/** Progressive cooking refinement time limit parm name */
+static NAMEPAIR BUDGET_NAME{ "budget", "Time Budget" };
+
+/** Antialiasing samples per axis of high contrast pixels parm name */
+static NAMEPAIR AASAMPLES_NAME{ "aasamples", "Antialias Samples" };
+
+/** Antialiasing contrast above which pixels are supersampled parm name */
+static NAMEPAIR AATHRESHOLD_NAME{ "aathreshold", "Antialias Contrast" };
+
 /** Pickover Fractal point position and line offset parm name */
 static NAMEPAIR POPOINT_NAME{ "popoint", "Pickover Point" };
 
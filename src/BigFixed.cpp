@@ -0,0 +1,327 @@
+/** \file BigFixed.cpp
+	Source defining the arbitrary precision fixed point number used by
+	deep zooms.
+ */
+
+ // Local
+#include "BigFixed.h"
+
+// STL
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+// HDK
+#include <SYS/SYS_Math.h>
+
+CC::BigFixed::BigFixed(int limbs) :
+	limbs(SYSmax(limbs, BIGFIXED_INT_LIMBS + 1), 0) {}
+
+int
+CC::BigFixed::limbs_for_spacing(fpreal64 spacing)
+{
+	int bits = 64;
+	if (spacing > 0.0 && spacing < 1.0)
+		bits += static_cast<int>(std::ceil(-std::log2(spacing)));
+
+	return BIGFIXED_INT_LIMBS + (bits + 31) / 32;
+}
+
+CC::BigFixed
+CC::BigFixed::from_double(fpreal64 value, int limbs)
+{
+	BigFixed result(limbs);
+	if (value == 0.0 || !std::isfinite(value))
+		return result;
+
+	result.negative = value < 0.0;
+
+	// value = mantissa * 2^(exponent - 53), with a 53 bit integer mantissa.
+	int exponent;
+	fpreal64 fraction = std::frexp(std::fabs(value), &exponent);
+	uint64 mantissa = static_cast<uint64>(std::ldexp(fraction, 53));
+
+	// Place each mantissa bit at its fixed point bit position, counted from
+	// the least significant bit of the last limb.
+	int total = result.get_limbs();
+	int frac_bits = 32 * (total - BIGFIXED_INT_LIMBS);
+	int shift = exponent - 53 + frac_bits;
+
+	for (int bit = 0; bit < 53; ++bit)
+	{
+		if (!(mantissa & (uint64(1) << bit)))
+			continue;
+
+		int position = bit + shift;
+		if (position < 0 || position >= 32 * total)
+			continue;
+
+		result.limbs[total - 1 - position / 32] |= uint32(1) << (position % 32);
+	}
+
+	return result;
+}
+
+CC::BigFixed
+CC::BigFixed::from_string(const std::string& value, int limbs)
+{
+	BigFixed result(limbs);
+
+	size_t i = 0;
+	while (i < value.size() && std::isspace((unsigned char)value[i]))
+		++i;
+
+	bool negative = false;
+	if (i < value.size() && (value[i] == '-' || value[i] == '+'))
+		negative = value[i++] == '-';
+
+	// Gather the digits, and where the decimal point falls within them.
+	std::string digits;
+	int point = -1;
+	for (; i < value.size(); ++i)
+	{
+		if (std::isdigit((unsigned char)value[i]))
+			digits.push_back(value[i]);
+		else if (value[i] == '.' && point < 0)
+			point = static_cast<int>(digits.size());
+		else
+			break;
+	}
+
+	if (point < 0)
+		point = static_cast<int>(digits.size());
+
+	// Scientific notation moves the decimal point.
+	if (i < value.size() && (value[i] == 'e' || value[i] == 'E'))
+		point += std::atoi(value.c_str() + i + 1);
+
+	// Integer part, accumulated into the integer limbs.
+	uint64 integer = 0;
+	for (int d = 0; d < point && d < (int)digits.size(); ++d)
+		integer = integer * 10 + (digits[d] - '0');
+	for (int d = static_cast<int>(digits.size()); d < point; ++d)
+		integer *= 10;
+
+	result.limbs[BIGFIXED_INT_LIMBS - 1] = static_cast<uint32>(integer);
+	if (BIGFIXED_INT_LIMBS > 1)
+		result.limbs[BIGFIXED_INT_LIMBS - 2] =
+			static_cast<uint32>(integer >> 32);
+
+	// Fractional part, from the least significant digit up:
+	// fraction = (digit + fraction) / 10
+	int total = result.get_limbs();
+	for (int d = static_cast<int>(digits.size()) - 1; d >= SYSmax(point, 0); --d)
+	{
+		uint64 remainder = digits[d] - '0';
+		for (int limb = BIGFIXED_INT_LIMBS; limb < total; ++limb)
+		{
+			uint64 current = (remainder << 32) | result.limbs[limb];
+			result.limbs[limb] = static_cast<uint32>(current / 10);
+			remainder = current % 10;
+		}
+	}
+
+	// Leading zeros implied by a negative point position.
+	for (int d = point; d < 0; ++d)
+	{
+		uint64 remainder = 0;
+		for (int limb = BIGFIXED_INT_LIMBS; limb < total; ++limb)
+		{
+			uint64 current = (remainder << 32) | result.limbs[limb];
+			result.limbs[limb] = static_cast<uint32>(current / 10);
+			remainder = current % 10;
+		}
+	}
+
+	result.negative = negative && !result.is_zero();
+	return result;
+}
+
+fpreal64
+CC::BigFixed::to_double() const
+{
+	// Sum from the least significant limb, so the largest terms land last.
+	fpreal64 value = 0.0;
+	for (int i = get_limbs() - 1; i >= 0; --i)
+	{
+		if (limbs[i])
+			value += std::ldexp(
+				static_cast<fpreal64>(limbs[i]),
+				32 * (BIGFIXED_INT_LIMBS - 1 - i));
+	}
+
+	return negative ? -value : value;
+}
+
+bool
+CC::BigFixed::is_zero() const
+{
+	for (uint32 limb : limbs)
+		if (limb)
+			return false;
+	return true;
+}
+
+int
+CC::BigFixed::compare_magnitude(const BigFixed& a, const BigFixed& b)
+{
+	for (int i = 0; i < a.get_limbs(); ++i)
+	{
+		if (a.limbs[i] != b.limbs[i])
+			return a.limbs[i] < b.limbs[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+CC::BigFixed
+CC::BigFixed::add_magnitude(const BigFixed& a, const BigFixed& b)
+{
+	BigFixed result(a.get_limbs());
+	uint64 carry = 0;
+	for (int i = a.get_limbs() - 1; i >= 0; --i)
+	{
+		uint64 sum = uint64(a.limbs[i]) + b.limbs[i] + carry;
+		result.limbs[i] = static_cast<uint32>(sum);
+		carry = sum >> 32;
+	}
+	return result;
+}
+
+CC::BigFixed
+CC::BigFixed::sub_magnitude(const BigFixed& a, const BigFixed& b)
+{
+	BigFixed result(a.get_limbs());
+	int64 borrow = 0;
+	for (int i = a.get_limbs() - 1; i >= 0; --i)
+	{
+		int64 difference = int64(a.limbs[i]) - b.limbs[i] - borrow;
+		borrow = difference < 0;
+		result.limbs[i] = static_cast<uint32>(difference + (borrow << 32));
+	}
+	return result;
+}
+
+CC::BigFixed
+CC::BigFixed::operator+(const BigFixed& other) const
+{
+	if (negative == other.negative)
+	{
+		BigFixed result = add_magnitude(*this, other);
+		result.negative = negative;
+		return result;
+	}
+
+	// Mixed signs subtract the smaller magnitude from the larger.
+	if (compare_magnitude(*this, other) >= 0)
+	{
+		BigFixed result = sub_magnitude(*this, other);
+		result.negative = negative && !result.is_zero();
+		return result;
+	}
+
+	BigFixed result = sub_magnitude(other, *this);
+	result.negative = other.negative;
+	return result;
+}
+
+CC::BigFixed
+CC::BigFixed::operator-(const BigFixed& other) const
+{
+	return *this + (-other);
+}
+
+CC::BigFixed
+CC::BigFixed::operator-() const
+{
+	BigFixed result = *this;
+	result.negative = !negative && !is_zero();
+	return result;
+}
+
+CC::BigFixed
+CC::BigFixed::operator*(const BigFixed& other) const
+{
+	int total = get_limbs();
+
+	// Schoolbook product. The 64 bit product of limbs i and j is split
+	// between product[i + j] (high half) and product[i + j + 1] (low half).
+	std::vector<uint64> product(2 * total, 0);
+	for (int i = 0; i < total; ++i)
+	{
+		if (!limbs[i])
+			continue;
+
+		for (int j = 0; j < total; ++j)
+		{
+			uint64 term = uint64(limbs[i]) * other.limbs[j];
+			product[i + j] += term >> 32;
+			product[i + j + 1] += term & 0xffffffff;
+		}
+	}
+
+	for (int k = 2 * total - 1; k > 0; --k)
+	{
+		product[k - 1] += product[k] >> 32;
+		product[k] &= 0xffffffff;
+	}
+
+	// Keep the limbs aligned with our binary point, truncating the rest.
+	BigFixed result(total);
+	for (int k = 0; k < total; ++k)
+		result.limbs[k] = static_cast<uint32>(product[k + BIGFIXED_INT_LIMBS]);
+
+	result.negative = (negative != other.negative) && !result.is_zero();
+	return result;
+}
+
+CC::BigComplex
+CC::BigComplex::from_complex(COMPLEX value, int limbs)
+{
+	return BigComplex(
+		BigFixed::from_double(value.real(), limbs),
+		BigFixed::from_double(value.imag(), limbs));
+}
+
+CC::BigComplex
+CC::BigComplex::operator+(const BigComplex& other) const
+{
+	return BigComplex(real + other.real, imag + other.imag);
+}
+
+CC::BigComplex
+CC::BigComplex::operator*(const BigComplex& other) const
+{
+	return BigComplex(
+		real * other.real - imag * other.imag,
+		real * other.imag + imag * other.real);
+}
+
+CC::BigComplex
+CC::BigComplex::pow(int exponent) const
+{
+	// Repeated squaring, as in ipow from Mandelbrot.h.
+	BigComplex result = *this;
+	BigComplex base = *this;
+	bool first = true;
+
+	while (exponent > 0)
+	{
+		if (exponent & 1)
+		{
+			result = first ? base : result * base;
+			first = false;
+		}
+
+		exponent >>= 1;
+		if (exponent)
+			base = base * base;
+	}
+
+	return result;
+}
+
+COMPLEX
+CC::BigComplex::to_complex() const
+{
+	return COMPLEX(real.to_double(), imag.to_double());
+}
@@ -0,0 +1,77 @@
+/** \file BuddhabrotCache.cpp
+	Source defining the cache of Buddhabrot histograms kept between cooks.
+ */
+
+ // Local
+#include "BuddhabrotCache.h"
+
+CC::BuddhabrotCacheKey::BuddhabrotCacheKey(
+	const MandelbrotStashData& data,
+	const FractalSpace& space,
+	int size_x,
+	int size_y,
+	int seed,
+	int sampling,
+	bool importance,
+	int region,
+	fpreal regionradius,
+	const std::vector<int>& bands,
+	const fpreal32* input) :
+	iters(data.iters), power(data.power), bailout(data.bailout),
+	jdepth(data.jdepth), joffset(data.joffset), blackhole(data.blackhole),
+	periodicity(data.periodicity), periodtol(data.periodtol),
+	size_x(size_x), size_y(size_y), seed(seed), sampling(sampling),
+	importance(importance), region(region), regionradius(regionradius),
+	bands(bands),
+	input(input, input + static_cast<exint>(size_x) * size_y)
+{
+	// Pixel coordinates are affine, so these fix all of them.
+	origin = space.get_origin();
+	step_x = space.get_step_x();
+	step_y = space.get_step_y();
+}
+
+bool
+CC::BuddhabrotCacheKey::operator==(const BuddhabrotCacheKey& other) const
+{
+	return iters == other.iters &&
+		power == other.power &&
+		bailout == other.bailout &&
+		jdepth == other.jdepth &&
+		joffset == other.joffset &&
+		blackhole == other.blackhole &&
+		periodicity == other.periodicity &&
+		periodtol == other.periodtol &&
+		origin == other.origin &&
+		step_x == other.step_x &&
+		step_y == other.step_y &&
+		size_x == other.size_x &&
+		size_y == other.size_y &&
+		seed == other.seed &&
+		sampling == other.sampling &&
+		importance == other.importance &&
+		region == other.region &&
+		regionradius == other.regionradius &&
+		bands == other.bands &&
+		input == other.input;
+}
+
+void
+CC::BuddhabrotCache::set_key(const BuddhabrotCacheKey& new_key)
+{
+	if (new_key == key)
+		return;
+
+	key = new_key;
+	samples = 0;
+	histogram.clear();
+}
+
+void
+CC::BuddhabrotCache::clear()
+{
+	UT_AutoLock lock_histogram(lock);
+	key = BuddhabrotCacheKey();
+	samples = 0;
+	histogram = std::vector<uint32>();
+}
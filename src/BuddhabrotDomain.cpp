@@ -0,0 +1,61 @@
+/** \file BuddhabrotDomain.cpp
+	Source defining the region of the complex plane a Buddhabrot samples.
+ */
+
+ // Local
+#include "BuddhabrotDomain.h"
+
+// STL
+#include <cmath>
+
+CC::BuddhabrotDomain::BuddhabrotDomain(
+	BuddhabrotRegion region,
+	fpreal radius,
+	const FractalSpace& space,
+	int size_x,
+	int size_y) :
+	region(region), radius(radius), space(space),
+	size_x(size_x), size_y(size_y)
+{
+}
+
+COMPLEX
+CC::BuddhabrotDomain::get_fractal_coords(fpreal64 u, fpreal64 v) const
+{
+	if (region == BuddhabrotRegion::IMAGE)
+		return space.get_fractal_coords(
+			COMPLEX(u * (size_x - 1), v * (size_y - 1)));
+
+	// Shirley and Chiu's concentric map sends squares around the center to
+	// rings of the disk, keeping areas, so stratified values stay
+	// stratified.
+	fpreal64 a = 2.0 * u - 1.0;
+	fpreal64 b = 2.0 * v - 1.0;
+	if (a == 0.0 && b == 0.0)
+		return COMPLEX(0.0, 0.0);
+
+	fpreal64 r, theta;
+	if (std::abs(a) > std::abs(b))
+	{
+		r = a;
+		theta = M_PI_4 * (b / a);
+	}
+	else
+	{
+		r = b;
+		theta = M_PI_2 - M_PI_4 * (a / b);
+	}
+	r *= radius;
+	return COMPLEX(r * std::cos(theta), r * std::sin(theta));
+}
+
+bool
+CC::BuddhabrotDomain::contains(const COMPLEX& c) const
+{
+	if (region == BuddhabrotRegion::DISK)
+		return std::norm(c) < radius * radius;
+
+	COMPLEX image_coords = space.get_image_coords(c);
+	return image_coords.real() >= 0.0 && image_coords.real() <= size_x - 1 &&
+		image_coords.imag() >= 0.0 && image_coords.imag() <= size_y - 1;
+}
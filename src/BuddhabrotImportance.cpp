@@ -0,0 +1,116 @@
+/** \file BuddhabrotImportance.cpp
+	Source defining the importance map used to place Buddhabrot samples.
+ */
+
+ // Local
+#include "BuddhabrotImportance.h"
+
+// STL
+#include <algorithm>
+
+// HDK
+#include <UT/UT_ParallelUtil.h>
+
+namespace
+{
+/**Returns the index of the interval of a cumulative distribution holding
+ * x, and writes the position of x within it to fraction.*/
+int
+sample_cdf(const fpreal64* cdf, int size, fpreal64 x, fpreal64& fraction)
+{
+	int index = static_cast<int>(
+		std::upper_bound(cdf + 1, cdf + size, x) - (cdf + 1));
+	fraction = (x - cdf[index]) / (cdf[index + 1] - cdf[index]);
+	fraction = SYSclamp(fraction, 0.0, 1.0);
+	return index;
+}
+}
+
+CC::BuddhabrotImportance::BuddhabrotImportance(
+	const Mandelbrot& fractal,
+	const BuddhabrotDomain& domain) :
+	cells_x(BUDDHABROT_IMPORTANCE_CELLS),
+	cells_y(BUDDHABROT_IMPORTANCE_CELLS)
+{
+	// The fraction of an orbit a sample would draw, at each cell corner.
+	const int corners_x = cells_x + 1;
+	std::vector<fpreal64> drawn(static_cast<exint>(corners_x) * (cells_y + 1));
+	const int iters = SYSmax(fractal.data.iters, 1);
+
+	UTparallelFor(UT_BlockedRange<int>(0, cells_y + 1),
+		[&](const UT_BlockedRange<int>& range)
+	{
+		Mandelbrot rowFractal = fractal;
+		for (int y = range.begin(); y < range.end(); y++)
+			for (int x = 0; x < corners_x; x++)
+			{
+				int n = rowFractal.calculate(domain.get_fractal_coords(
+					static_cast<fpreal64>(x) / cells_x,
+					static_cast<fpreal64>(y) / cells_y)).num_iter;
+
+				// Bounded orbits are drawn whole without the blackhole, and
+				// not at all with it, which reports them as -1.
+				drawn[y * corners_x + x] = SYSmax(n, 0) /
+					static_cast<fpreal64>(iters);
+			}
+	});
+
+	// A cell is as important as its best corner, so thin filaments between
+	// corners aren't starved. Densities are the inverse of the weights.
+	weights.resize(static_cast<exint>(cells_x) * cells_y);
+	std::vector<fpreal64> density(weights.size());
+	fpreal64 total{ 0.0 };
+	for (int y = 0; y < cells_y; y++)
+		for (int x = 0; x < cells_x; x++)
+		{
+			const fpreal64* row = &drawn[y * corners_x + x];
+			fpreal64 importance = SYSmax(
+				SYSmax(row[0], row[1]),
+				SYSmax(row[corners_x], row[corners_x + 1]));
+
+			uint32 weight = BUDDHABROT_IMPORTANCE_RANGE;
+			if (importance * BUDDHABROT_IMPORTANCE_RANGE > 1.0)
+				weight = static_cast<uint32>(SYSrint(1.0 / importance));
+
+			exint cell = y * cells_x + x;
+			weights[cell] = weight;
+			density[cell] = 1.0 / weight;
+			total += density[cell];
+		}
+
+	// A cell's density relative to uniform sampling is
+	// cells / (weight * total), so a sample counting as its weight is off
+	// from its unbiased weight by total / cells, the same for every cell.
+	scale = total / weights.size();
+
+	row_cdf.assign(cells_y + 1, 0.0);
+	cell_cdf.assign(static_cast<exint>(cells_x + 1) * cells_y, 0.0);
+	for (int y = 0; y < cells_y; y++)
+	{
+		fpreal64* cdf = &cell_cdf[y * (cells_x + 1)];
+		for (int x = 0; x < cells_x; x++)
+			cdf[x + 1] = cdf[x] + density[y * cells_x + x];
+
+		row_cdf[y + 1] = row_cdf[y] + cdf[cells_x];
+		for (int x = 1; x <= cells_x; x++)
+			cdf[x] /= cdf[cells_x];
+	}
+	for (int y = 1; y <= cells_y; y++)
+		row_cdf[y] /= row_cdf[cells_y];
+}
+
+uint32
+CC::BuddhabrotImportance::warp(fpreal64& u, fpreal64& v) const
+{
+	// Rows are chosen by v, then the cell within the row by u, so samples
+	// spread evenly over the square stay spread evenly over each cell.
+	fpreal64 fraction_y;
+	int y = sample_cdf(row_cdf.data(), cells_y, v, fraction_y);
+	fpreal64 fraction_x;
+	int x = sample_cdf(
+		&cell_cdf[y * (cells_x + 1)], cells_x, u, fraction_x);
+
+	u = SYSmin((x + fraction_x) / cells_x, 1.0);
+	v = SYSmin((y + fraction_y) / cells_y, 1.0);
+	return weights[y * cells_x + x];
+}
@@ -4,33 +4,93 @@
 
  // Local
 #include "COP2_Buddhabrot.h"
+#include "MandelbrotSIMD.h"
+
+// STL
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
 
 // HDK
 #include <CH/CH_Manager.h>
 #include <COP2/COP2_CookAreaInfo.h>
+#include <UT/UT_ParallelUtil.h>
+#include <UT/UT_Thread.h>
 
 /** Parm Switcher used by this interface to generate default generator parms */
-COP_MASK_SWITCHER(18, "Fractal");
+COP_MASK_SWITCHER(27, "Fractal");
 
 // Declare Parm Names
 static PRM_Name nameSamples("samples", "Samples");
+static PRM_Name nameSampling("sampling", "Sampling");
+static PRM_Name nameImportance("importance", "Importance Sampling");
+static PRM_Name nameRegion("samplingregion", "Sampling Region");
+static PRM_Name nameRegionRadius("regionradius", "Region Radius");
 static PRM_Name nameSeed("seed", "Seed");
+static PRM_Name nameCacheSamples("cachesamples", "Cache Samples");
 static PRM_Name nameNormalize("normalize", "Normalize");
 static PRM_Name nameMaxval("maxval", "Maximum Raw Value");
+static PRM_Name nameNebulabrot("nebulabrot", "Nebulabrot");
+static PRM_Name nameNebulaIters("nebulaiters", "Band Iterations");
 static PRM_Name nameDisplayReferenceFractal(
 	"displayreffractal", "Display Reference Fractal");
 
+// Declare Sampling Menu, ordered as BuddhabrotSampling
+static PRM_Name menuNameSampling[]
+{
+	PRM_Name("uniform", "Uniform"),
+	PRM_Name("metropolis", "Metropolis-Hastings"),
+	PRM_Name("sobol", "Sobol"),
+	PRM_Name("halton", "Halton"),
+	PRM_Name(0)
+};
+
+static PRM_ChoiceList menuSampling
+(
+(PRM_ChoiceListType)(PRM_CHOICELIST_EXCLUSIVE | PRM_CHOICELIST_REPLACE),
+menuNameSampling
+);
+
+// Declare Sampling Region Menu, ordered as BuddhabrotRegion
+static PRM_Name menuNameRegion[]
+{
+	PRM_Name("disk", "Disk"),
+	PRM_Name("image", "Image"),
+	PRM_Name(0)
+};
+
+static PRM_ChoiceList menuRegion
+(
+(PRM_ChoiceListType)(PRM_CHOICELIST_EXCLUSIVE | PRM_CHOICELIST_REPLACE),
+menuNameRegion
+);
+
 // Declare Parm Defaults
 static PRM_Default defaultSamples{ 0.05 };  // Sample by 5% of image size.
 static PRM_Default defaultMaxval{ -1 };  // Off by default
+static PRM_Default defaultRegionRadius{ 2.0 };  // Holds the whole set.
+static PRM_Default defaultNebulaIters[] = { 5000, 500, 50 };
 
 // Deflare Parm Ranges
+static PRM_Range rangeNebulaIters
+{
+	PRM_RangeFlag::PRM_RANGE_RESTRICTED, 1,
+	PRM_RangeFlag::PRM_RANGE_UI, 5000
+};
+
 static PRM_Range rangeSamples
 {
 	PRM_RangeFlag::PRM_RANGE_RESTRICTED, 0.01,
 	PRM_RangeFlag::PRM_RANGE_UI, 5
 };
 
+static PRM_Range rangeRegionRadius
+{
+	PRM_RangeFlag::PRM_RANGE_RESTRICTED, 0,
+	PRM_RangeFlag::PRM_RANGE_UI, 4
+};
+
 static PRM_Range rangeMaxval
 {
 	PRM_RangeFlag::PRM_RANGE_RESTRICTED, -1,
@@ -50,10 +110,24 @@ CC::COP2_Buddhabrot::myTemplateList[]
 	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, &nameSepB),
 	PRM_Template(PRM_FLT_J, TOOL_PARM, 1, &nameSamples,
 		&defaultSamples, 0, &rangeSamples),
+	PRM_Template(PRM_INT_J, TOOL_PARM, 1,
+		&nameSampling, PRMzeroDefaults, &menuSampling),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1,
+		&nameImportance, PRMzeroDefaults),
+	PRM_Template(PRM_INT_J, TOOL_PARM, 1,
+		&nameRegion, PRMzeroDefaults, &menuRegion),
+	PRM_Template(PRM_FLT_J, TOOL_PARM, 1,
+		&nameRegionRadius, &defaultRegionRadius, 0, &rangeRegionRadius),
 	PRM_Template(PRM_INT_J, TOOL_PARM, 1, &nameSeed, PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1,
+		&nameCacheSamples, PRMoneDefaults),
 	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &nameNormalize, PRMoneDefaults),
 	PRM_Template(PRM_INT_J, TOOL_PARM, 1,
 		&nameMaxval, &defaultMaxval, 0, &rangeMaxval),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1,
+		&nameNebulabrot, PRMzeroDefaults),
+	PRM_Template(PRM_INT_J, TOOL_PARM, NEBULABROT_BANDS,
+		&nameNebulaIters, defaultNebulaIters, 0, &rangeNebulaIters),
 	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, &nameSepC),
 	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1,
 		&nameDisplayReferenceFractal, PRMoneDefaults),
@@ -114,17 +188,39 @@ CC::COP2_Buddhabrot::newContextData
 
 	MandelbrotStashData mandelData;
 	mandelData.evalArgs(this, t);
+	mandelData.fit_period_tolerance(std::abs(data->space.get_step_x()));
 	data->fractal = Mandelbrot(mandelData);
 
 	// Node-Specific Parms
 
 	data->samples = evalFloat(nameSamples.getToken(), 0, t);
+	data->sampling = static_cast<BuddhabrotSampling>(
+		evalInt(nameSampling.getToken(), 0, t));
+	data->importance = evalInt(nameImportance.getToken(), 0, t);
+	data->region = static_cast<BuddhabrotRegion>(
+		evalInt(nameRegion.getToken(), 0, t));
+	data->regionradius = evalFloat(nameRegionRadius.getToken(), 0, t);
 	data->seed = evalInt(nameSeed.getToken(), 0, t);
 	data->normalize = evalInt(nameNormalize.getToken(), 0, t);
 	data->maxval = evalInt(nameMaxval.getToken(), 0, t);
 	data->displayreffractal = evalInt(
 		nameDisplayReferenceFractal.getToken(), 0, t);
 
+	// Nebulabrots iterate every sample to the largest of their bands.
+	data->nebulabrot = evalInt(nameNebulabrot.getToken(), 0, t);
+	for (int band = 0; band < NEBULABROT_BANDS; band++)
+		data->bands[band] = evalInt(nameNebulaIters.getToken(), band, t);
+	if (data->nebulabrot)
+		data->fractal.data.iters = *std::max_element(
+			data->bands, data->bands + NEBULABROT_BANDS);
+
+	// Histograms are cached on the node, so they outlive the cook. The
+	// cache is keyed once the input image is known, see filterImage.
+	if (!evalInt(nameCacheSamples.getToken(), 0, t))
+		sample_cache.clear();
+	else
+		data->sample_cache = &sample_cache;
+
 	return data;
 }
 
@@ -142,6 +238,11 @@ CC::COP2_Buddhabrot::updateParmsFlags()
 	// Determine If Normalizing
 	fpreal t = CHgetEvalTime();
 	bool normalize = evalInt(nameNormalize.getToken(), 0, t);
+	bool nebulabrot = evalInt(nameNebulabrot.getToken(), 0, t);
+	bool metropolis = evalInt(nameSampling.getToken(), 0, t) ==
+		static_cast<int>(BuddhabrotSampling::METROPOLIS);
+	bool disk = evalInt(nameRegion.getToken(), 0, t) ==
+		static_cast<int>(BuddhabrotRegion::DISK);
 
 	// Set variables for hiding
 	bool displayMaxval{ false };
@@ -156,6 +257,17 @@ CC::COP2_Buddhabrot::updateParmsFlags()
 
 	changed |= setVisibleState(nameMaxval.getToken(), displayMaxval);
 
+	// Markov chains already favour important samples.
+	changed |= setVisibleState(nameImportance.getToken(), !metropolis);
+	changed |= setVisibleState(nameRegionRadius.getToken(), disk);
+
+	// Nebulabrots draw their green band where the reference fractal would
+	// go, and take their iterations from the bands.
+	changed |= setVisibleState(nameNebulaIters.getToken(), nebulabrot);
+	changed |= setVisibleState(ITERS_NAME.first, !nebulabrot);
+	changed |= setVisibleState(
+		nameDisplayReferenceFractal.getToken(), !nebulabrot);
+
 	return changed;
 }
 
@@ -180,36 +292,161 @@ CC::COP2_Buddhabrot::getInputDependenciesForOutputArea(
 	getMaskDependency(output_area, input_areas, needed_areas);
 }
 
-std::vector<COMPLEX>
-CC::COP2_Buddhabrot::buddhabrotPoints(
-	Mandelbrot* fractal, const COMPLEX & c, unsigned int nIterations)
+int
+CC::COP2_Buddhabrot::buddhabrotLength(
+	Mandelbrot& fractal,
+	const COMPLEX& c,
+	int nIterations,
+	const FractalSpace& space,
+	int size_x,
+	int size_y)
 {
-	std::vector<COMPLEX> points;
-	points.reserve(nIterations);
+	// Without the blackhole, bounded orbits are drawn too, up to the second
+	// pass finding where they escape.
+	if (!fractal.data.blackhole)
+		return nIterations;
+
+	// Skip iterating the main cardioid and period-2 bulb altogether.
+	if (fractal.data.allows_interior_test() &&
+		in_cardioid_or_bulb(c.real(), c.imag()))
+		return 0;
 
 	COMPLEX z{ 0 };
 	int n{ 0 };
 
+	// Orbits found to be periodic would never escape. See
+	// Mandelbrot::calculate_kernel.
+	bool check_period = fractal.data.periodicity;
+	fpreal period_tol_sq = fractal.data.periodtol * fractal.data.periodtol;
+	COMPLEX checkpoint{ 0 };
+	exint refresh{ 1 };
+
+	// Orbits that never cross the image draw nothing, which is most of them
+	// when the sampled domain is larger than the image. Points are tested
+	// until one lands inside.
+	bool inside{ false };
+
 	while (n < nIterations)
 	{
 		++n;
-		z = fractal->calculate_z(z, c);
+		z = fractal.calculate_z(z, c);
 
-		if (abs(z) > fractal->data.bailout)
+		if (abs(z) > fractal.data.bailout)
 			break;
 
-		points.push_back(z);
+		if (!inside)
+		{
+			exint pixel;
+			space.get_pixel_indices(&z, 1, size_x, size_y, &pixel);
+			inside = pixel >= 0;
+		}
 
+		if (check_period)
+		{
+			if (std::norm(z - checkpoint) < period_tol_sq)
+				return 0;
+
+			if (n == refresh)
+			{
+				checkpoint = z;
+				refresh *= 2;
+			}
+		}
 	};
 
-	// Return nothing if the point is bounded within the mandelbrot set
-	if (fractal->data.blackhole)
+	// Orbits reaching the last iteration count as bounded. Escaping orbits
+	// draw every point before the one that escaped.
+	return n < nIterations && inside ? n - 1 : 0;
+}
+
+template <typename Splat>
+void
+CC::COP2_Buddhabrot::splatOrbit(
+	COP2_BuddhabrotData* sdata,
+	const COP2_Context& context,
+	const char* idata,
+	Mandelbrot& fractal,
+	const COMPLEX& c,
+	Splat splat)
+{
+	// Look at the sample's input as a multiplier on the iters. Samples
+	// outside of the image extend its edges.
+	WORLDPIXELCOORDS inputPixelCoords = sdata->space.get_pixel_coords(c);
+	const fpreal32* inputPixel = (const fpreal32 *)idata;
+
+	inputPixel +=
+		SYSclamp(inputPixelCoords.first, 0, context.myXsize - 1) +
+		SYSclamp(inputPixelCoords.second, 0, context.myYsize - 1) *
+		static_cast<exint>(context.myXsize);
+	fpreal multiplier = abs(*inputPixel);
+
+	// Iteration limit of each band, all of which share the orbit's points.
+	const int numBands = sdata->nebulabrot ? NEBULABROT_BANDS : 1;
+	int limits[NEBULABROT_BANDS];
+	int nIters{ 0 };
+	for (int band = 0; band < numBands; band++)
 	{
-		if (n == nIterations)
-			return std::vector<COMPLEX>();
+		int bandIters = sdata->nebulabrot ?
+			sdata->bands[band] : fractal.data.iters;
+		limits[band] = (int)SYSrint(multiplier * bandIters);
+		nIters = SYSmax(nIters, limits[band]);
 	}
 
-	return points;
+	// The first pass only decides whether the orbit is drawn at all, so
+	// bounded orbits never store their points.
+	int length = buddhabrotLength(fractal, c, nIters,
+		sdata->space, context.myXsize, context.myYsize);
+	if (!length)
+		return;
+
+	// With the blackhole on, a band only draws orbits escaping within its
+	// own limit.
+	unsigned drawn{ 0 };
+	for (int band = 0; band < numBands; band++)
+		if (!fractal.data.blackhole || length + 1 < limits[band])
+			drawn |= 1u << band;
+	if (!drawn)
+		return;
+
+	// The second pass iterates the orbit again, mapping its points to
+	// output pixels a chunk at a time.
+	COMPLEX points[BUDDHABROT_ORBIT_CHUNK];
+	unsigned pointBands[BUDDHABROT_ORBIT_CHUNK];
+	exint pixels[BUDDHABROT_ORBIT_CHUNK];
+	int count{ 0 };
+
+	auto flush = [&]()
+	{
+		sdata->space.get_pixel_indices(
+			points, count, context.myXsize, context.myYsize, pixels);
+		for (int i = 0; i < count; i++)
+			if (pixels[i] >= 0)
+				splat(pixels[i], pointBands[i]);
+		count = 0;
+	};
+
+	COMPLEX z{ 0 };
+	for (int n = 0; n < length; n++)
+	{
+		z = fractal.calculate_z(z, c);
+
+		if (abs(z) > fractal.data.bailout)
+			break;
+
+		// Bands drawing the point, which has the iteration count n + 1.
+		unsigned bands = drawn;
+		for (int band = 0; band < numBands; band++)
+			if (n >= limits[band])
+				bands &= ~(1u << band);
+		if (!bands)
+			break;
+
+		points[count] = z;
+		pointBands[count++] = bands;
+		if (count == BUDDHABROT_ORBIT_CHUNK)
+			flush();
+	}
+	flush();
 }
 
 OP_ERROR
@@ -239,68 +476,364 @@ CC::COP2_Buddhabrot::filter(
 	return ((COP2_Buddhabrot*)me)->filterImage(context, input, output);
 }
 
-int
+std::vector<fpreal32>
 CC::COP2_Buddhabrot::evaluateBuddhabrot(
 	COP2_BuddhabrotData* sdata,
 	const COP2_Context& context,
 	char* idata,
-	char* odata,
-	std::mt19937& rng,
-	const int numSamples)
+	const std::vector<char*>& odata,
+	const exint numSamples,
+	BuddhabrotCache* cache)
 {
-	// Declare highest sample value, which may be used by the normalize method.
-	int highest_sample_value;
+	const exint numPixels =
+		static_cast<exint>(context.myXsize) * context.myYsize;
+	const int numBands = static_cast<int>(odata.size());
+	const exint histogramSize = numBands * numPixels;
+	const Philox rng(sdata->seed);
+	const Sobol sobol(sdata->seed);
+	const Halton halton(sdata->seed);
+	const BuddhabrotDomain domain(sdata->region, sdata->regionradius,
+		sdata->space, context.myXsize, context.myYsize);
+
+	// The importance map is cheap next to the samples, so it's rebuilt
+	// every cook rather than cached.
+	std::unique_ptr<BuddhabrotImportance> importance;
+	if (sdata->importance)
+		importance.reset(
+			new BuddhabrotImportance(sdata->fractal, domain));
+
+	// Only the samples missing from the cache are taken. Caches with more
+	// samples than asked for start over.
+	exint firstSample{ 0 };
+	if (cache)
+	{
+		if (cache->samples > numSamples ||
+			static_cast<exint>(cache->histogram.size()) != histogramSize)
+		{
+			cache->histogram.assign(histogramSize, 0);
+			cache->samples = 0;
+		}
+		firstSample = cache->samples;
+	}
+	const exint newSamples = numSamples - firstSample;
+
+	// Samples are split into a fixed number of tasks, each counting into its
+	// own histogram. Counts are integers, so the summed image is the same no
+	// matter which thread ran each task.
+	const int numTasks = static_cast<int>(SYSmax(SYSmin(
+		static_cast<exint>(UT_Thread::getNumProcessors()),
+		newSamples / BUDDHABROT_MIN_TASK_SAMPLES), exint(1)));
+
+	// Histograms of every task may not fit in memory for large images, in
+	// which case tasks share one and count with atomic increments.
+	// Bands are stored one after another.
+	const bool shared =
+		numTasks * histogramSize * sizeof(uint32) > BUDDHABROT_HISTOGRAM_BYTES;
+	std::vector<std::vector<uint32>> histograms(shared ? 0 : numTasks);
+	std::unique_ptr<std::atomic<uint32>[]> sharedHistogram;
+	if (shared)
+		sharedHistogram.reset(new std::atomic<uint32>[histogramSize]());
+
+	auto accumulate = [&](int task)
+	{
+		exint begin = firstSample + newSamples * task / numTasks;
+		exint end = firstSample + newSamples * (task + 1) / numTasks;
 
-	// Choose a random x, y coordinate along the image plane.
-	// The '0's refer to lower left corner, the second argument the upper right
-	std::uniform_real_distribution<fpreal> realDistribution(
-		0, context.myXsize - 1);
-	std::uniform_real_distribution<fpreal> imagDistribution(
-		0, context.myYsize - 1);
+		if (!shared)
+			histograms[task].assign(histogramSize, 0);
 
-	for (exint idxSample = 0; idxSample < numSamples; idxSample++)
+		// Each task iterates its own copy of the fractal.
+		Mandelbrot fractal = sdata->fractal;
+
+		for (exint idxSample = begin; idxSample < end; idxSample++)
+		{
+			// Choose a position in the unit square, mapped onto the domain.
+			fpreal u, v;
+			switch (sdata->sampling)
+			{
+			case BuddhabrotSampling::SOBOL:
+				sobol.sample2(idxSample, u, v);
+				break;
+			case BuddhabrotSampling::HALTON:
+				halton.sample2(idxSample, u, v);
+				break;
+			default:
+				rng.uniform2(idxSample, 0, u, v);
+				break;
+			}
+			const uint32 weight = importance ? importance->warp(u, v) : 1;
+			COMPLEX sample = domain.get_fractal_coords(u, v);
+
+			if (shared)
+				splatOrbit(sdata, context, idata, fractal, sample,
+					[&](exint samplePixel, unsigned bands)
+				{
+					for (int band = 0; bands; band++, bands >>= 1)
+						if (bands & 1)
+							sharedHistogram[band * numPixels + samplePixel]
+								.fetch_add(weight, std::memory_order_relaxed);
+				});
+			else
+				splatOrbit(sdata, context, idata, fractal, sample,
+					[&](exint samplePixel, unsigned bands)
+				{
+					for (int band = 0; bands; band++, bands >>= 1)
+						if (bands & 1)
+							histograms[task][band * numPixels + samplePixel] +=
+								weight;
+				});
+		}
+	};
+
+	UTparallelFor(UT_BlockedRange<int>(0, numTasks),
+		[&](const UT_BlockedRange<int>& range)
 	{
-		COMPLEX sample(realDistribution(rng), imagDistribution(rng));
-		COMPLEX fractalCoords = sdata->space.get_fractal_coords(sample);
+		for (int task = range.begin(); task < range.end(); task++)
+			accumulate(task);
+	}, 1, 1);
+
+	// Sum the histograms into the output and the cache, in parallel over
+	// pixels. Weighted counts are scaled back to uniform counts.
+	const fpreal64 scale = importance ? importance->get_scale() : 1.0;
+	for (int band = 0; band < numBands; band++)
+	{
+		fpreal32* outputPixels = (fpreal32 *)odata[band];
+		if (!outputPixels && !cache)
+			continue;
 
+		const exint offset = band * numPixels;
+		UTparallelFor(UT_BlockedRange<exint>(0, numPixels),
+			[&](const UT_BlockedRange<exint>& range)
+		{
+			for (exint pixel = range.begin(); pixel < range.end(); pixel++)
+			{
+				uint32 count = cache ? cache->histogram[offset + pixel] : 0;
+				if (shared)
+					count += sharedHistogram[offset + pixel].load(
+						std::memory_order_relaxed);
+				else
+					for (const std::vector<uint32>& histogram : histograms)
+						count += histogram[offset + pixel];
+
+				if (cache)
+					cache->histogram[offset + pixel] = count;
+				if (outputPixels)
+					outputPixels[pixel] = static_cast<fpreal32>(count * scale);
+			}
+		});
+	}
 
-		// Look at the sample's input as a multiplier on the iters
-		WORLDPIXELCOORDS inputPixelCoords =
-			sdata->space.get_pixel_coords(fractalCoords);
-		fpreal32* inputPixel = (fpreal32 *)idata;
+	if (cache)
+		cache->samples = numSamples;
 
-		inputPixel +=
-			inputPixelCoords.first + inputPixelCoords.second * context.myXsize;
-		// The buddhabrotPoints function takes unsigned integers.
-		int nIters =
-			(int)SYSrint(abs(*inputPixel) * sdata->fractal.data.iters);
-		std::vector<COMPLEX> points =
-			buddhabrotPoints(&sdata->fractal, fractalCoords, nIters);
+	return highestSampleValues(context, odata);
+}
 
-		for (COMPLEX& point : points)
+std::vector<fpreal32>
+CC::COP2_Buddhabrot::metropolisBuddhabrot(
+	COP2_BuddhabrotData* sdata,
+	const COP2_Context& context,
+	char* idata,
+	const std::vector<char*>& odata,
+	const exint numSamples)
+{
+	const exint numPixels =
+		static_cast<exint>(context.myXsize) * context.myYsize;
+	const int numBands = static_cast<int>(odata.size());
+	const exint histogramSize = numBands * numPixels;
+	const Philox rng(sdata->seed);
+
+	// Chains each keep their own histogram of weighted contributions. Their
+	// number depends only on the image, keeping the floating point sums the
+	// same for any thread count.
+	const exint budgetChains =
+		BUDDHABROT_HISTOGRAM_BYTES / (histogramSize * sizeof(fpreal32));
+	const int numChains = static_cast<int>(SYSmax(SYSmin(SYSmin(
+		BUDDHABROT_CHAINS, budgetChains),
+		numSamples / BUDDHABROT_MIN_TASK_SAMPLES), exint(1)));
+
+	std::vector<std::vector<fpreal32>> histograms(numChains);
+
+	// Orbit contributions of the chains' uniform samples, which estimate the
+	// mean contribution over the image used to reweight the histograms.
+	std::vector<fpreal> uniformSum(numChains, 0.0);
+	std::vector<exint> uniformCount(numChains, 0);
+	std::vector<exint> chainSteps(numChains, 0);
+
+	const BuddhabrotDomain domain(sdata->region, sdata->regionradius,
+		sdata->space, context.myXsize, context.myYsize);
+	const fpreal radiusRange = std::log(BUDDHABROT_MUTATION_RANGE);
+
+	// Small moves are sized in pixels of the image, whatever the domain.
+	const COMPLEX stepX = sdata->space.get_step_x();
+	const COMPLEX stepY = sdata->space.get_step_y();
+	const fpreal pixelSize = std::sqrt(std::abs(
+		stepX.real() * stepY.imag() - stepX.imag() * stepY.real()));
+
+	auto runChain = [&](int chain)
+	{
+		exint begin = numSamples * chain / numChains;
+		exint end = numSamples * (chain + 1) / numChains;
+
+		// Stream 0 belongs to uniform sampling.
+		const uint64 seedStream = 3 * static_cast<uint64>(chain) + 1;
+		const uint64 stepStream = seedStream + 1;
+		const uint64 proposalStream = seedStream + 2;
+
+		// Each chain iterates its own copy of the fractal, and keeps the
+		// image pixels of its current and proposed orbits in buffers reused
+		// between steps.
+		Mandelbrot fractal = sdata->fractal;
+		std::vector<exint> current, proposed;
+		COMPLEX currentSample;
+		exint currentInside{ 0 };
+		fpreal u, v;
+
+		// Collects the histogram entries of a sample's orbit, and returns
+		// how many of its points land inside the image.
+		auto orbitPixels = [&](
+			const COMPLEX& sample, std::vector<exint>& pixels)
 		{
-			fpreal32 *outputPixel = (fpreal32 *)odata;
+			pixels.clear();
+			exint inside{ 0 };
+			splatOrbit(sdata, context, idata, fractal, sample,
+				[&](exint samplePixel, unsigned bands)
+			{
+				inside++;
+				for (int band = 0; bands; band++, bands >>= 1)
+					if (bands & 1)
+						pixels.push_back(band * numPixels + samplePixel);
+			});
+			return inside;
+		};
+
+		// Start from a uniform sample whose orbit reaches the image.
+		for (exint i = 0; i < BUDDHABROT_SEED_TRIES && !currentInside; i++)
+		{
+			rng.uniform2(i, seedStream, u, v);
+			currentSample = domain.get_fractal_coords(u, v);
+			currentInside = orbitPixels(currentSample, current);
+			uniformSum[chain] += currentInside;
+			uniformCount[chain]++;
+		}
+
+		if (!currentInside)
+			return;
 
-			WORLDPIXELCOORDS samplePixelCoords =
-				sdata->space.get_pixel_coords(point);
-			int samplePixel =
-				samplePixelCoords.first +
-				(samplePixelCoords.second * context.myXsize);
+		histograms[chain].assign(histogramSize, 0.0f);
+		chainSteps[chain] = end - begin;
 
-			if (samplePixel >= 0 && samplePixel <=
-				context.myXsize * context.myYsize)
+		for (exint step = begin; step < end; step++)
+		{
+			fpreal mutation, acceptance;
+			rng.uniform2(step, stepStream, mutation, acceptance);
+			rng.uniform2(step, proposalStream, u, v);
+
+			// Propose either a fresh uniform sample, or a small move from
+			// the current one with a radius spread evenly in scale.
+			bool large = mutation < BUDDHABROT_LARGE_STEP;
+			COMPLEX proposal;
+			if (large)
+				proposal = domain.get_fractal_coords(u, v);
+			else
+				proposal = currentSample + std::polar(
+					BUDDHABROT_MUTATION_RADIUS * pixelSize *
+					std::exp(-radiusRange * u),
+					2.0 * M_PI * v);
+
+			// Samples outside of the domain have no contribution.
+			exint proposedInside{ 0 };
+			if (domain.contains(proposal))
+				proposedInside = orbitPixels(proposal, proposed);
+
+			if (large)
 			{
-				outputPixel += samplePixel;
-				++*outputPixel;
+				uniformSum[chain] += proposedInside;
+				uniformCount[chain]++;
+			}
 
-				// Save the highest output pixel value sampled
-				if (*outputPixel > highest_sample_value)
-					highest_sample_value = static_cast<uint32_t>(*outputPixel);
+			// Both proposals are symmetric, so a move is accepted with the
+			// ratio of the two contributions.
+			if (acceptance * currentInside < proposedInside)
+			{
+				currentSample = proposal;
+				currentInside = proposedInside;
+				std::swap(current, proposed);
 			}
+
+			// Weighting the current orbit by its inverse contribution makes
+			// every step add one in total, undoing the chain's preference.
+			fpreal32 weight = 1.0f / currentInside;
+			for (exint samplePixel : current)
+				histograms[chain][samplePixel] += weight;
 		}
+	};
+
+	UTparallelFor(UT_BlockedRange<int>(0, numChains),
+		[&](const UT_BlockedRange<int>& range)
+	{
+		for (int chain = range.begin(); chain < range.end(); chain++)
+			runChain(chain);
+	}, 1, 1);
+
+	// Scale the histograms to the counts uniform sampling would converge to
+	// with the same number of samples.
+	fpreal sum{ 0.0 };
+	exint count{ 0 }, steps{ 0 };
+	for (int chain = 0; chain < numChains; chain++)
+	{
+		sum += uniformSum[chain];
+		count += uniformCount[chain];
+		steps += chainSteps[chain];
+	}
+	const fpreal32 scale = steps ?
+		static_cast<fpreal32>(sum / count * numSamples / steps) : 0.0f;
+
+	for (int band = 0; band < numBands; band++)
+	{
+		fpreal32* outputPixels = (fpreal32 *)odata[band];
+		if (!outputPixels)
+			continue;
+
+		const exint offset = band * numPixels;
+		UTparallelFor(UT_BlockedRange<exint>(0, numPixels),
+			[&](const UT_BlockedRange<exint>& range)
+		{
+			for (exint pixel = range.begin(); pixel < range.end(); pixel++)
+			{
+				fpreal32 value{ 0.0f };
+				for (const std::vector<fpreal32>& histogram : histograms)
+					if (!histogram.empty())
+						value += histogram[offset + pixel];
+				outputPixels[pixel] = value * scale;
+			}
+		});
 	}
 
-	return highest_sample_value;
+	return highestSampleValues(context, odata);
+}
+
+std::vector<fpreal32>
+CC::COP2_Buddhabrot::highestSampleValues(
+	const COP2_Context& context,
+	const std::vector<char*>& odata)
+{
+	const exint numPixels =
+		static_cast<exint>(context.myXsize) * context.myYsize;
+
+	// Return the highest output pixel value sampled of each band, which may
+	// be used by the normalize method.
+	std::vector<fpreal32> highest(odata.size(), 0.0f);
+	for (size_t band = 0; band < odata.size(); band++)
+	{
+		const fpreal32* outputPixels = (const fpreal32 *)odata[band];
+		if (!outputPixels)
+			continue;
+
+		for (exint pixel = 0; pixel < numPixels; pixel++)
+			highest[band] = SYSmax(highest[band], outputPixels[pixel]);
+	}
+	return highest;
 }
 
 void
@@ -308,7 +841,7 @@ CC::COP2_Buddhabrot::normalizeBuddhabrot(
 	COP2_BuddhabrotData* sdata,
 	const COP2_Context& context,
 	char* odata,
-	int highest_sample_value)
+	fpreal32 highest_sample_value)
 {
 	// Normalize to highest sample value if needed
 	if (sdata->normalize)
@@ -382,10 +915,14 @@ CC::COP2_Buddhabrot::filterImage(
 	int x, y;
 	char *idata, *odata;
 
-	std::mt19937 rng;
-	rng.seed(sdata->seed);
+	// The Buddhabrot's bands are written to the first channels of the
+	// plane, and read their iterations from the input's first channel.
+	const int numBands = sdata->nebulabrot ? NEBULABROT_BANDS : 1;
+	std::vector<char*> bandData(numBands, nullptr);
+	char* bandInput = (char *)input->getImageData(0);
 
-	// Scale num of samples to the size of the image.
+	// Scale num of samples to the size of the image. They're spread over
+	// the whole sampling domain, not just the image.
 	exint numSamples = SYSrint(
 		context.myXsize * context.myYsize * sdata->samples);
 
@@ -416,25 +953,13 @@ CC::COP2_Buddhabrot::filterImage(
 
 		if (idata && odata)
 		{
-			if (comp == 0) // First plane only
+			if (comp < numBands)
 			{
-				int highest_sample_value = evaluateBuddhabrot(
-					sdata,
-					context,
-					idata,
-					odata,
-					rng,
-					numSamples);
-
-				normalizeBuddhabrot(
-					sdata,
-					context,
-					odata,
-					highest_sample_value);
-
+				bandData[comp] = odata;
 			}
 			// Display reference fractal in second image plane
-			else if (comp == 1 && sdata->displayreffractal)
+			else if (comp == 1 && sdata->displayreffractal &&
+				!sdata->nebulabrot)
 			{
 				displayReferenceFractal(
 					sdata,
@@ -446,5 +971,44 @@ CC::COP2_Buddhabrot::filterImage(
 		}
 	}
 
+	// Every band is drawn from one set of samples.
+	if (bandInput && bandData[0])
+	{
+		std::vector<fpreal32> highest_sample_values;
+		if (sdata->sampling == BuddhabrotSampling::METROPOLIS)
+			highest_sample_values = metropolisBuddhabrot(
+				sdata, context, bandInput, bandData, numSamples);
+		else if (sdata->sample_cache)
+		{
+			// Add to the histogram of the last cook, if it had the same key.
+			BuddhabrotCache& cache = *sdata->sample_cache;
+			UT_AutoLock lock_cache(cache.lock);
+
+			std::vector<int> bands;
+			if (sdata->nebulabrot)
+				bands.assign(sdata->bands, sdata->bands + NEBULABROT_BANDS);
+			cache.set_key(BuddhabrotCacheKey(
+				sdata->fractal.data, sdata->space,
+				context.myXsize, context.myYsize, sdata->seed,
+				static_cast<int>(sdata->sampling), sdata->importance,
+				static_cast<int>(sdata->region), sdata->regionradius, bands,
+				(const fpreal32 *)bandInput));
+
+			highest_sample_values = evaluateBuddhabrot(
+				sdata, context, bandInput, bandData, numSamples, &cache);
+		}
+		else
+			highest_sample_values = evaluateBuddhabrot(
+				sdata, context, bandInput, bandData, numSamples, nullptr);
+
+		for (int band = 0; band < numBands; band++)
+			if (bandData[band])
+				normalizeBuddhabrot(
+					sdata,
+					context,
+					bandData[band],
+					highest_sample_values[band]);
+	}
+
 	return error();
 }
\ No newline at end of file
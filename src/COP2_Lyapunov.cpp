@@ -6,7 +6,10 @@
 #include "COP2_Lyapunov.h"
 #include "FractalNode.h"
 
-COP_GENERATOR_SWITCHER(10, "Fractal");
+// STL
+#include <algorithm>
+
+COP_GENERATOR_SWITCHER(16, "Fractal");
 
 
 CC::COP2_Lyapunov::COP2_Lyapunov(
@@ -49,6 +52,22 @@ CC::COP2_Lyapunov::newContextData
 	lyaData.evalArgs(this, t);
 	data->fractal = Lyapunov(lyaData);
 
+	// The deadline starts with the cook.
+	ProgressiveStashData progressiveData;
+	progressiveData.evalArgs(this, t);
+	data->progressive = progressiveData.enable;
+	data->deadline = CookDeadline(progressiveData.budget);
+
+	// Tiles left coarse by the last cook are refined from where they
+	// stopped, as long as nothing changed since.
+	if (data->progressive)
+		progressive_cache.set_key(
+			ProgressiveKey(this, t, image_sizex, image_sizey));
+	else
+		progressive_cache.clear();
+
+	data->antialias.evalArgs(this, t);
+
 	return data;
 }
 
@@ -75,6 +94,8 @@ CC::COP2_Lyapunov::myTemplateList[]
 	TEMPLATES_XFORM,
 	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, &nameSepA),
 	TEMPLATES_LYAPUNOV,
+	TEMPLATES_PROGRESSIVE,
+	TEMPLATES_ANTIALIAS,
 	PRM_Template()
 };
 
@@ -93,28 +114,22 @@ CC::COP2_Lyapunov::generateTile(COP2_Context& context, TIL_TileList* tileList)
 
 	// Forward declaring values
 	int size_x, size_y;
-	exint i;  // Huge because number of pixels may be crazy
-	WORLDPIXELCOORDS worldPixel;
-	COMPLEX fractalCoords;
+
 	// Comes from TIL/TIL_Tile.h
 	FOR_EACH_UNCOOKED_TILE(tileList, tile, tileIndex)
 	{
 		tile->getSize(size_x, size_y);
 
-		for (exint i = 0; i < size_x * size_y; i++)
+		if (tileIndex == 0)
+		{
+			calculate_smooth_tile(this, data->fractal, data->space,
+				data->antialias,
+				data->progressive ? &progressive_cache : nullptr,
+				data->deadline, data->refining, tileList, tile, dest);
+		}
+		else
 		{
-			if (tileIndex == 0)
-			{
-				WORLDPIXELCOORDS worldPixel = CC::calculate_world_pixel(
-					tileList, tile, i);
-				COMPLEX fractalCoords = data->space.get_fractal_coords(
-					worldPixel);
-				FractalCoordsInfo pixelInfo = data->fractal.calculate(
-					fractalCoords);
-
-				dest[i] = pixelInfo.smooth;
-			}
-			else
+			for (exint i = 0; i < static_cast<exint>(size_x) * size_y; i++)
 				dest[i] = 0.0f;
 		}
 
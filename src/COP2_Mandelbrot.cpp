@@ -8,9 +8,461 @@
 // HDK
 #include <CH/CH_Manager.h>
 #include <PRM/PRM_ChoiceList.h>
+#include <SYS/SYS_Math.h>
+
+// STL
+#include <cstring>
+#include <numeric>
+#include <vector>
 
 /** Parm Switcher used by this interface to generate default generator parms */
-COP_GENERATOR_SWITCHER(12, "Fractal");
+COP_GENERATOR_SWITCHER(41, "Fractal");
+
+namespace
+{
+/**Rectangles with both sides shorter than this are calculated outright, as
+ * they have too few interior pixels left to be worth tracing.*/
+const int TRACE_MIN_SIZE{ 8 };
+
+/**Most tiles kept with planes left to write.*/
+const exint MAX_CACHED_TILES{ 256 };
+
+/**Mariani-Silver subdivision of a tile. The border of a rectangle is
+ * calculated first, and when every border pixel has the same value the
+ * interior is filled with it. Otherwise the rectangle is split in two along
+ * its longer side, and each half is traced in turn. Calculate is called
+ * with batches of tile pixel indices, and writes num_iter and values.*/
+template <typename Calculate>
+class BoundaryTracer
+{
+	int size_x;
+	bool raw;
+	std::vector<int>& num_iter;
+	std::vector<fpreal64>& values;
+	Calculate& calculate;
+
+	/**Whether each pixel of the tile has been calculated or filled.*/
+	std::vector<char> known;
+	std::vector<exint> batch;
+
+	void add(int x, int y)
+	{
+		exint i = static_cast<exint>(y) * size_x + x;
+		if (known[i])
+			return;
+
+		known[i] = 1;
+		batch.push_back(i);
+	}
+
+	/**Calculates every pixel of the rectangle not known yet.*/
+	void calculate_rectangle(int x0, int y0, int x1, int y1)
+	{
+		batch.clear();
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				add(x, y);
+
+		if (!batch.empty())
+			calculate(batch);
+	}
+
+public:
+	BoundaryTracer(
+		int size_x,
+		int size_y,
+		bool raw,
+		std::vector<int>& num_iter,
+		std::vector<fpreal64>& values,
+		Calculate& calculate) :
+		size_x(size_x), raw(raw), num_iter(num_iter), values(values),
+		calculate(calculate),
+		known(static_cast<exint>(size_x) * size_y, 0) {}
+
+	/**Traces the rectangle [x0, x1] x [y0, y1], inclusive.*/
+	void trace(int x0, int y0, int x1, int y1)
+	{
+		batch.clear();
+		for (int x = x0; x <= x1; x++)
+		{
+			add(x, y0);
+			add(x, y1);
+		}
+		for (int y = y0 + 1; y < y1; y++)
+		{
+			add(x0, y);
+			add(x1, y);
+		}
+
+		if (!batch.empty())
+			calculate(batch);
+
+		// Nothing inside the border.
+		if (x1 - x0 < 2 || y1 - y0 < 2)
+			return;
+
+		// Smooth values and distances vary even within an iteration band, so
+		// only the blackholed interior is uniform outside of RAW mode.
+		exint first = static_cast<exint>(y0) * size_x + x0;
+		int value = num_iter[first];
+		bool uniform = raw || value == -1;
+
+		for (int x = x0; x <= x1 && uniform; x++)
+			uniform = num_iter[static_cast<exint>(y0) * size_x + x] == value &&
+				num_iter[static_cast<exint>(y1) * size_x + x] == value;
+		for (int y = y0 + 1; y < y1 && uniform; y++)
+			uniform = num_iter[static_cast<exint>(y) * size_x + x0] == value &&
+				num_iter[static_cast<exint>(y) * size_x + x1] == value;
+
+		if (uniform)
+		{
+			for (int y = y0 + 1; y < y1; y++)
+			{
+				for (int x = x0 + 1; x < x1; x++)
+				{
+					exint i = static_cast<exint>(y) * size_x + x;
+					num_iter[i] = value;
+					values[i] = values[first];
+					known[i] = 1;
+				}
+			}
+			return;
+		}
+
+		if (x1 - x0 < TRACE_MIN_SIZE && y1 - y0 < TRACE_MIN_SIZE)
+		{
+			calculate_rectangle(x0 + 1, y0 + 1, x1 - 1, y1 - 1);
+			return;
+		}
+
+		// The halves share the splitting line, which is only calculated once.
+		if (x1 - x0 >= y1 - y0)
+		{
+			int mid = (x0 + x1) / 2;
+			trace(x0, y0, mid, y1);
+			trace(mid, y0, x1, y1);
+		}
+		else
+		{
+			int mid = (y0 + y1) / 2;
+			trace(x0, y0, x1, mid);
+			trace(x0, mid, x1, y1);
+		}
+	}
+};
+
+/**Traces a whole tile. See BoundaryTracer.*/
+template <typename Calculate>
+void
+trace_tile(
+	int size_x,
+	int size_y,
+	bool raw,
+	std::vector<int>& num_iter,
+	std::vector<fpreal64>& values,
+	Calculate& calculate)
+{
+	BoundaryTracer<Calculate> tracer(
+		size_x, size_y, raw, num_iter, values, calculate);
+	tracer.trace(0, 0, size_x - 1, size_y - 1);
+}
+
+/**Shades pixels for the mode and fit. See COP2_MandelbrotData::shade.*/
+template <CC::MandelbrotMode Mode, bool Fit>
+void
+shade_pixels(
+	const CC::COP2_MandelbrotData& data,
+	const int* num_iter,
+	const fpreal64* values,
+	exint size,
+	fpreal32* dest)
+{
+	fpreal64 iters = data.fractal.data.iters;
+
+	for (exint i = 0; i < size; i++)
+	{
+		// Determine whether to return smooth or raw values
+		fpreal32 val = values[i];
+
+		if (Mode == CC::MandelbrotMode::RAW)
+			val = num_iter[i];
+
+		if (Mode == CC::MandelbrotMode::DISTANCE)
+		{
+			// Measured in pixels, so it reads the same at any zoom.
+			val = values[i] / data.pixel_size;
+
+			// Optionally compress the distances into a 0-1 range
+			if (Fit)
+				val = val / (1.0 + val);
+		}
+		// Optionally normalize the values
+		else if (Fit)
+			val /= iters;
+
+		// Assign value to the pixel
+		dest[i] = (fpreal32)val;
+	}
+}
+
+template <CC::MandelbrotMode Mode>
+CC::COP2_MandelbrotData::ShadeFunction
+select_shade(bool fit)
+{
+	if (fit)
+		return &shade_pixels<Mode, true>;
+	return &shade_pixels<Mode, false>;
+}
+
+/**Returns the shading function for the mode and fit.*/
+CC::COP2_MandelbrotData::ShadeFunction
+select_shade(CC::MandelbrotMode mode, bool fit)
+{
+	switch (mode)
+	{
+	case CC::MandelbrotMode::RAW:
+		return select_shade<CC::MandelbrotMode::RAW>(fit);
+	case CC::MandelbrotMode::DISTANCE:
+		return select_shade<CC::MandelbrotMode::DISTANCE>(fit);
+	case CC::MandelbrotMode::NORMALIZED:
+		return select_shade<CC::MandelbrotMode::NORMALIZED>(fit);
+	default:
+		return select_shade<CC::MandelbrotMode::SMOOTH>(fit);
+	}
+}
+
+/**Name and component names of each extra MandelbrotPlane. Scalar planes
+ * have no components.*/
+struct PlaneDefinition
+{
+	const char* name;
+	const char* components[3];
+};
+
+const PlaneDefinition PLANE_DEFINITIONS[CC::MAIN_PLANE]
+{
+	{ "iterations", { nullptr, nullptr, nullptr } },
+	{ "smooth", { nullptr, nullptr, nullptr } },
+	{ "z", { "x", "y", nullptr } },
+	{ "argument", { nullptr, nullptr, nullptr } },
+	{ "distance", { nullptr, nullptr, nullptr } },
+	{ "stripe", { nullptr, nullptr, nullptr } },
+	{ "trap", { nullptr, nullptr, nullptr } },
+	{ "N", { "x", "y", "z" } }
+};
+
+/**Returns the MandelbrotPlane of a plane, where any plane that isn't an
+ * extra plane is the main plane.*/
+CC::MandelbrotPlane
+find_plane(const TIL_Plane* plane)
+{
+	for (int i = 0; i < CC::MAIN_PLANE; i++)
+		if (std::strcmp(plane->getName(), PLANE_DEFINITIONS[i].name) == 0)
+			return static_cast<CC::MandelbrotPlane>(i);
+
+	return CC::MAIN_PLANE;
+}
+
+/**Calculates the orbit of every pixel of a tile once, and stores the values
+ * of every enabled plane in the cache.*/
+void
+calculate_planes(
+	CC::COP2_MandelbrotData& data,
+	TIL_TileList* tileList,
+	TIL_Tile* tile,
+	CC::MandelbrotTileCache& cache)
+{
+	int size_x, size_y;
+	tile->getSize(size_x, size_y);
+	exint num_pixels = static_cast<exint>(size_x) * size_y;
+
+	std::vector<int> num_iter(num_pixels);
+	std::vector<fpreal64> smooth(num_pixels), distance(num_pixels);
+	std::vector<COMPLEX> z(num_pixels), dz(num_pixels);
+	std::vector<fpreal64> stripe(num_pixels), trap(num_pixels);
+
+	if (data.deep.is_enabled())
+	{
+		// Deep zooms only provide the values of a perturbed orbit, leaving
+		// the stripe, trap and normal planes black.
+		std::vector<COMPLEX> deltas(num_pixels);
+		std::vector<CC::FractalCoordsInfo> infos(num_pixels);
+
+		for (exint i = 0; i < num_pixels; i++)
+			deltas[i] = data.deep.get_delta(
+				CC::calculate_world_pixel(tileList, tile, i));
+
+		if (data.features.distance)
+			data.deep.calculate_distance(
+				deltas.data(), num_pixels, infos.data());
+		else
+			data.deep.calculate(deltas.data(), num_pixels, infos.data());
+
+		for (exint i = 0; i < num_pixels; i++)
+		{
+			num_iter[i] = infos[i].num_iter;
+			smooth[i] = infos[i].smooth;
+			distance[i] = infos[i].distance;
+			z[i] = infos[i].z;
+		}
+	}
+	else
+	{
+		CC::OrbitFeatures features;
+		const CC::TileCoords coords(data.space, tileList, tile);
+
+		for (exint i = 0; i < num_pixels; i++)
+		{
+			CC::FractalCoordsInfo info = data.fractal.calculate_features(
+				coords[i], data.features, features);
+
+			num_iter[i] = info.num_iter;
+			smooth[i] = info.smooth;
+			distance[i] = info.distance;
+			z[i] = info.z;
+			dz[i] = features.dz;
+			stripe[i] = features.stripe;
+			trap[i] = features.trap;
+		}
+	}
+
+	// The main plane is shaded as without extra planes.
+	std::vector<fpreal32>& main = cache.planes[CC::MAIN_PLANE][0];
+	main.resize(num_pixels);
+	data.shade(data, num_iter.data(),
+		data.mode == CC::MandelbrotMode::DISTANCE ?
+		distance.data() : smooth.data(),
+		num_pixels, main.data());
+
+	for (int plane = 0; plane < CC::MAIN_PLANE; plane++)
+	{
+		if (!data.planes[plane])
+			continue;
+
+		std::vector<fpreal32>* components = cache.planes[plane];
+		for (int c = 0; c < 3; c++)
+			if (c == 0 || PLANE_DEFINITIONS[plane].components[c])
+				components[c].resize(num_pixels);
+
+		for (exint i = 0; i < num_pixels; i++)
+		{
+			// Orbits that never escaped have no meaningful final z.
+			bool escaped = num_iter[i] >= 0 &&
+				num_iter[i] < data.fractal.data.iters;
+
+			switch (plane)
+			{
+			case CC::ITERATIONS_PLANE:
+				components[0][i] = num_iter[i];
+				break;
+			case CC::SMOOTH_PLANE:
+				components[0][i] = smooth[i];
+				break;
+			case CC::Z_PLANE:
+				components[0][i] = z[i].real();
+				components[1][i] = z[i].imag();
+				break;
+			case CC::ARGUMENT_PLANE:
+				components[0][i] = escaped ?
+					std::arg(z[i]) / (2.0 * M_PI) + 0.5 : 0.0;
+				break;
+			case CC::DISTANCE_PLANE:
+				components[0][i] = distance[i] / data.pixel_size;
+				break;
+			case CC::STRIPE_PLANE:
+				components[0][i] = stripe[i];
+				break;
+			case CC::TRAP_PLANE:
+				components[0][i] = trap[i];
+				break;
+			case CC::NORMAL_PLANE:
+			{
+				// The potential's gradient points along z / dz. Tilted
+				// halfway up from the image plane, it shades as a relief.
+				COMPLEX u{ 0.0 };
+				if (escaped && std::norm(dz[i]) > 0.0)
+					u = z[i] / dz[i];
+				fpreal length = std::abs(u);
+				if (length > 0.0)
+					u /= length * M_SQRT2;
+
+				components[0][i] = u.real();
+				components[1][i] = u.imag();
+				components[2][i] = length > 0.0 ? M_SQRT1_2 : 1.0;
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+}
+
+/**Returns the cache of a tile, calculating it if no other plane has yet.*/
+std::shared_ptr<CC::MandelbrotTileCache>
+acquire_tile(
+	CC::COP2_MandelbrotData& data,
+	TIL_TileList* tileList,
+	TIL_Tile* tile)
+{
+	std::shared_ptr<CC::MandelbrotTileCache> cache;
+	{
+		UT_AutoLock lock(data.tiles_lock);
+		std::shared_ptr<CC::MandelbrotTileCache>& entry =
+			data.tiles[std::make_pair(tileList->myX1, tileList->myY1)];
+
+		if (!entry)
+		{
+			entry = std::make_shared<CC::MandelbrotTileCache>();
+			entry->unwritten = 1;
+			for (int plane = 0; plane < CC::MAIN_PLANE; plane++)
+				entry->unwritten += data.planes[plane];
+			entry->stamp = ++data.tiles_stamp;
+		}
+		cache = entry;
+
+		// Planes that are never cooked never release their tiles. Evicting
+		// the oldest only makes its remaining planes calculate it again.
+		if (static_cast<exint>(data.tiles.size()) > MAX_CACHED_TILES)
+		{
+			auto oldest = data.tiles.begin();
+			for (auto it = data.tiles.begin(); it != data.tiles.end(); ++it)
+				if (it->second->stamp < oldest->second->stamp)
+					oldest = it;
+			data.tiles.erase(oldest);
+		}
+	}
+
+	// Other planes of the tile wait here for its single calculation.
+	UT_AutoLock lock(cache->lock);
+	if (!cache->calculated)
+	{
+		calculate_planes(data, tileList, tile, *cache);
+		cache->calculated = true;
+	}
+	return cache;
+}
+
+/**Marks a plane of a tile as written, and releases the tile once every
+ * plane has been. Planes cooked again after that calculate it again.*/
+void
+release_tile(
+	CC::COP2_MandelbrotData& data,
+	TIL_TileList* tileList,
+	const std::shared_ptr<CC::MandelbrotTileCache>& cache)
+{
+	{
+		UT_AutoLock lock(cache->lock);
+		if (--cache->unwritten > 0)
+			return;
+	}
+
+	UT_AutoLock lock(data.tiles_lock);
+	auto entry = data.tiles.find(std::make_pair(tileList->myX1, tileList->myY1));
+	if (entry != data.tiles.end() && entry->second == cache)
+		data.tiles.erase(entry);
+}
+}  // End of anonymous Namespace
 
 
 CC::COP2_Mandelbrot::COP2_Mandelbrot(
@@ -22,12 +474,34 @@ CC::COP2_Mandelbrot::COP2_Mandelbrot(
 // Parm Name
 static PRM_Name nameMode("mode", "Mode");
 static PRM_Name nameFit("fit", "Fit");
+static PRM_Name nameDistCutoff("distcutoff", "Distance Cutoff");
+static PRM_Name nameDistCutoffPixels("distcutoffpx", "Cutoff Pixels");
+static PRM_Name nameTrace("trace", "Boundary Tracing");
+static PRM_Name namePrecision("precision", "Precision");
+static PRM_Name nameCacheOrbits("cacheorbits", "Cache Orbits");
+static PRM_Name nameStripeDensity("stripedensity", "Stripe Density");
+static PRM_Name nameTrapPoint("trappoint", "Trap Point");
+
+// Toggles for each extra MandelbrotPlane
+static PRM_Name namePlanes[] =
+{
+	PRM_Name("planeiterations", "Iterations Plane"),
+	PRM_Name("planesmooth", "Smooth Plane"),
+	PRM_Name("planez", "Z Plane"),
+	PRM_Name("planeargument", "Argument Plane"),
+	PRM_Name("planedistance", "Distance Plane"),
+	PRM_Name("planestripe", "Stripe Plane"),
+	PRM_Name("planetrap", "Trap Plane"),
+	PRM_Name("planenormal", "Normal Plane")
+};
 
 // ChoiceList Lists
 static PRM_Name modeMenuNames[] =
 {
 	PRM_Name("smooth", "Smooth"),
 	PRM_Name("raw", "Raw"),
+	PRM_Name("distance", "Distance"),
+	PRM_Name("normalized", "Normalized"),
 	PRM_Name(0)
 };
 
@@ -37,9 +511,28 @@ static PRM_ChoiceList modeMenu
 ::modeMenuNames
 );
 
+// Auto, followed by the Precision enum values.
+static PRM_Name precisionMenuNames[] =
+{
+	PRM_Name("auto", "Auto"),
+	PRM_Name("single", "Single"),
+	PRM_Name("double", "Double"),
+	PRM_Name("doubledouble", "Double-Double"),
+	PRM_Name(0)
+};
+
+static PRM_ChoiceList precisionMenu
+(
+(PRM_ChoiceListType)(PRM_CHOICELIST_EXCLUSIVE | PRM_CHOICELIST_REPLACE),
+::precisionMenuNames
+);
+
 // Declare Parm Defaults
 static PRM_Default defaultModeMenu{ 0 };
 static PRM_Default defaultFit{ 1 };
+static PRM_Default defaultDistCutoffPixels{ 16.0 };
+static PRM_Default defaultPrecision{ 2 };  // Double
+static PRM_Default defaultStripeDensity{ 5.0 };
 
 
 PRM_Template
@@ -47,12 +540,34 @@ CC::COP2_Mandelbrot::myTemplateList[]
 {
 	TEMPLATE_SWITCHER,
 	TEMPLATES_XFORM_MULTI,
+	TEMPLATES_DEEPZOOM,
 	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, &nameSepA),
 	TEMPLATES_MANDELBROT,
 	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, &nameSepB),
 	PRM_Template(
 		PRM_INT_J, TOOL_PARM, 1, &nameMode, &defaultModeMenu, &modeMenu),
 	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &nameFit, &defaultFit),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &nameDistCutoff, PRMzeroDefaults),
+	PRM_Template(PRM_FLT_J, TOOL_PARM, 1, &nameDistCutoffPixels,
+		&defaultDistCutoffPixels),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &nameTrace, PRMzeroDefaults),
+	PRM_Template(PRM_INT_J, TOOL_PARM, 1, &namePrecision,
+		&defaultPrecision, &precisionMenu),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &nameCacheOrbits, PRMzeroDefaults),
+	TEMPLATES_PROGRESSIVE,
+	TEMPLATES_ANTIALIAS,
+	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, &nameSepC),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[0], PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[1], PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[2], PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[3], PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[4], PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[5], PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[6], PRMzeroDefaults),
+	PRM_Template(PRM_TOGGLE_J, TOOL_PARM, 1, &namePlanes[7], PRMzeroDefaults),
+	PRM_Template(PRM_FLT_J, TOOL_PARM, 1, &nameStripeDensity,
+		&defaultStripeDensity),
+	PRM_Template(PRM_FLT_J, TOOL_PARM, 2, &nameTrapPoint, PRMzeroDefaults),
 	PRM_Template()
 };
 
@@ -78,6 +593,20 @@ CC::COP2_Mandelbrot::cookSequenceInfo(OP_ERROR& error)
 {
 	COP2_Generator::cookSequenceInfo(error);
 
+	// Add the enabled extra planes, see MandelbrotPlane.
+	fpreal t = CHgetEvalTime();
+	for (int plane = 0; plane < MAIN_PLANE; plane++)
+	{
+		if (!evalInt(namePlanes[plane].getToken(), 0, t))
+			continue;
+
+		const PlaneDefinition& definition = PLANE_DEFINITIONS[plane];
+		mySequence.addPlane(definition.name, TILE_FLOAT32,
+			definition.components[0],
+			definition.components[1],
+			definition.components[2]);
+	}
+
 	return &mySequence;
 }
 
@@ -105,16 +634,98 @@ CC::COP2_Mandelbrot::newContextData
 	multiXformData.evalArgs(this, t);
 	data->space.set_xform(multiXformData);
 
+	// Node-specific parms
+	data->mode = static_cast<MandelbrotMode>(
+		evalInt(nameMode.getToken(), 0, t));
+
+	for (int plane = 0; plane < MAIN_PLANE; plane++)
+	{
+		data->planes[plane] = evalInt(namePlanes[plane].getToken(), 0, t);
+		data->extra_planes |= data->planes[plane];
+	}
+
+	data->features.stripe_density = evalFloat(
+		nameStripeDensity.getToken(), 0, t);
+	data->features.trap_point = COMPLEX(
+		evalFloat(nameTrapPoint.getToken(), 0, t),
+		evalFloat(nameTrapPoint.getToken(), 1, t));
+	data->features.distance = data->mode == MandelbrotMode::DISTANCE ||
+		data->planes[DISTANCE_PLANE];
+
 	// Stash mandelbrot Data
 	MandelbrotStashData mandelData;
 	mandelData.evalArgs(this, t);
+	mandelData.fit_period_tolerance(std::abs(data->space.get_step_x()));
+	if (data->mode == MandelbrotMode::NORMALIZED)
+		mandelData.smoothing = SmoothingMode::NORMALIZED;
+	else if (!data->planes[SMOOTH_PLANE] && (
+		data->mode == MandelbrotMode::RAW ||
+		data->mode == MandelbrotMode::DISTANCE))
+		mandelData.smoothing = SmoothingMode::NONE;
 	data->fractal = Mandelbrot(mandelData);
 
-	// Node-specific parms
-	data->mode = static_cast<MandelbrotMode>(
-		evalInt(nameMode.getToken(), 0, t));
+	// Stash deep zoom data, iterating the frame's reference orbit.
+	DeepZoomStashData deepData;
+	deepData.evalArgs(this, t);
+	data->deep = DeepZoom(deepData, mandelData, image_sizex, image_sizey);
 
 	data->fit = evalInt(nameFit.getToken(), 0, t);
+	data->shade = select_shade(data->mode, data->fit);
+
+	// Size of a pixel in fractal coordinates, to measure distances in pixels.
+	if (data->deep.is_enabled())
+		data->pixel_size = data->deep.get_spacing();
+	else
+		data->pixel_size = std::abs(
+			data->space.get_fractal_coords(WORLDPIXELCOORDS(1, 0)) -
+			data->space.get_fractal_coords(WORLDPIXELCOORDS(0, 0)));
+
+	if (data->pixel_size <= 0.0)
+		data->pixel_size = 1.0;
+
+	if (evalInt(nameDistCutoff.getToken(), 0, t))
+		data->fractal.distance_cutoff = data->pixel_size * evalFloat(
+			nameDistCutoffPixels.getToken(), 0, t);
+
+	data->trace = evalInt(nameTrace.getToken(), 0, t);
+
+	// The deadline starts with the cook. Deep zoom batches pick their own
+	// references, so their pixels depend on the batch.
+	ProgressiveStashData progressiveData;
+	progressiveData.evalArgs(this, t);
+	data->progressive = progressiveData.enable && !data->deep.is_enabled();
+	data->deadline = CookDeadline(progressiveData.budget);
+
+	// Tiles left coarse by the last cook are refined from where they
+	// stopped, as long as nothing changed since.
+	if (data->progressive)
+		progressive_cache.set_key(
+			ProgressiveKey(this, t, image_sizex, image_sizey));
+	else
+		progressive_cache.clear();
+
+	data->antialias.evalArgs(this, t);
+
+	// Orbits are cached on the node, so they outlive the cook. Deep zooms,
+	// distances and extra planes need more than the cached state.
+	if (!evalInt(nameCacheOrbits.getToken(), 0, t))
+		orbit_cache.clear();
+	else if (!data->deep.is_enabled() && !data->extra_planes &&
+		data->mode != MandelbrotMode::DISTANCE)
+	{
+		orbit_cache.set_key(OrbitCacheKey(mandelData, data->space));
+		data->orbit_cache = &orbit_cache;
+	}
+
+	// One precision for the whole image, so neighbouring tiles can't
+	// differ. Auto only moves past Double where it can't resolve pixels.
+	int precision = evalInt(namePrecision.getToken(), 0, t);
+	if (precision == 0)
+		data->precision = data->space.get_precision(
+			WORLDPIXELCOORDS(0, 0),
+			WORLDPIXELCOORDS(image_sizex - 1, image_sizey - 1));
+	else
+		data->precision = static_cast<Precision>(precision - 1);
 
 	return data;
 }
@@ -136,48 +747,304 @@ CC::COP2_Mandelbrot::generateTile(
 
 	// Forward declaring values
 	int size_x, size_y;
-	exint i;  // Huge because number of pixels may be crazy
-	WORLDPIXELCOORDS worldPixel;
-	COMPLEX fractalCoords;
+	exint num_pixels;  // Huge because number of pixels may be crazy
+
+	// Structure-of-arrays batch data, so pixels can be calculated together.
+	std::vector<fpreal64> real, imag, batch_values;
+	std::vector<int> batch_iter;
+	std::vector<OrbitState> resume_states;
+
+	// Deep zoom pixels, as offsets from the view center.
+	std::vector<COMPLEX> deltas;
+	std::vector<FractalCoordsInfo> infos;
+
+	// Results for every pixel of the tile. Values are smooth values, or
+	// distance estimates in DISTANCE mode.
+	MandelbrotProgressiveSamples samples;
+	std::vector<fpreal64>& values = samples.values;
+	std::vector<int>& num_iter = samples.num_iter;
+	std::vector<exint> pixels;
+
+	bool smooth_mode = data->mode == MandelbrotMode::SMOOTH ||
+		data->mode == MandelbrotMode::NORMALIZED;
+	bool distance_mode = data->mode == MandelbrotMode::DISTANCE;
+
+	// With extra planes, every plane of a tile is written from a single
+	// orbit pass, cached until each plane has been written.
+	if (data->extra_planes)
+	{
+		MandelbrotPlane plane = find_plane(tileList->myPlane);
+		std::shared_ptr<MandelbrotTileCache> cache;
+
+		FOR_EACH_UNCOOKED_TILE(tileList, tile, tileIndex)
+		{
+			if (!cache)
+				cache = acquire_tile(*data, tileList, tile);
+
+			tile->getSize(size_x, size_y);
+			num_pixels = size_x * size_y;
+
+			const std::vector<fpreal32>& values =
+				cache->planes[plane][SYSmin(tileIndex, 2)];
+			for (exint i = 0; i < num_pixels; i++)
+				dest[i] = values.empty() ? 0.0f : values[i];
+
+			writeFPtoTile(tileList, dest, tileIndex);
+		}
+
+		if (cache)
+			release_tile(*data, tileList, cache);
+
+		delete[] dest;
+		return error();
+	}
+
 	// Comes from TIL/TIL_Tile.h
 	FOR_EACH_UNCOOKED_TILE(tileList, tile, tileIndex)
 	{
 		tile->getSize(size_x, size_y);
+		num_pixels = size_x * size_y;
 
-		// For each pixel in tile...
-		for (exint i = 0; i < size_x * size_y; i++)
+		// Only calculate the fractal for the first Red Channel
+		if (tileIndex == 0)
 		{
-			// Only calculate the fractal for the first Red Channel
-			if (tileIndex == 0)
+			values.resize(num_pixels);
+			num_iter.resize(num_pixels);
+
+			Precision precision = data->precision;
+
+			// Orbit states of the tile. Double-double tiles aren't cached.
+			std::shared_ptr<OrbitCacheTile> orbit_tile;
+			if (data->orbit_cache && precision != Precision::DOUBLE_DOUBLE)
+				orbit_tile = data->orbit_cache->get_tile(
+					tileList->myX1, tileList->myY1, num_pixels);
+
+			const TileCoords coords(data->space, tileList, tile);
+
+			// Calculates a batch of the tile's pixels, given by index.
+			auto calculate_pixels = [&](const std::vector<exint>& batch)
 			{
-				// Get the 'world pixel coords from tile.
-				WORLDPIXELCOORDS worldPixel = CC::calculate_world_pixel(
-					tileList,
-					tile,
-					i);
+				exint count = batch.size();
 
-				// Convert those to 'fractal space'
-				COMPLEX fractalCoords = data->space.get_fractal_coords(
-					worldPixel);
+				if (data->deep.is_enabled())
+				{
+					// Perturb each pixel around the frame's reference orbit.
+					deltas.resize(count);
+					infos.resize(count);
 
-				// Calculate the fratal from the new fractal coordinates
-				FractalCoordsInfo pixelInfo = data->fractal.calculate(
-					fractalCoords);
+					for (exint i = 0; i < count; i++)
+						deltas[i] = data->deep.get_delta(
+							CC::calculate_world_pixel(tileList, tile, batch[i]));
 
-				// Determine whether to return smooth or raw values
-				fpreal32 val = pixelInfo.smooth;
+					if (distance_mode)
+						data->deep.calculate_distance(
+							deltas.data(), count, infos.data());
+					else
+						data->deep.calculate(deltas.data(), count, infos.data());
 
-				if (data->mode == MandelbrotMode::RAW)
-					val = pixelInfo.num_iter;
+					for (exint i = 0; i < count; i++)
+					{
+						num_iter[batch[i]] = infos[i].num_iter;
+						values[batch[i]] = distance_mode ?
+							infos[i].distance : infos[i].smooth;
+					}
+					return;
+				}
 
-				// Optionally normalize the values
-				if (data->fit)
-					val /= (fpreal64)data->fractal.data.iters;
+				// Views too deep for fpreal64 iterate in double-double.
+				// Distance estimates stay in double precision.
+				if (precision == Precision::DOUBLE_DOUBLE && !distance_mode)
+				{
+					for (exint i = 0; i < count; i++)
+					{
+						FractalCoordsInfo pixelInfo = data->fractal.calculate_dd(
+							data->space.get_fractal_coords_dd(
+								CC::calculate_world_pixel(tileList, tile, batch[i])));
+						num_iter[batch[i]] = pixelInfo.num_iter;
+						values[batch[i]] = pixelInfo.smooth;
+					}
+					return;
+				}
 
-				// Assign value to the pixel
-				dest[i] = (fpreal32)val;
+				real.resize(count);
+				imag.resize(count);
+				batch_iter.resize(count);
+				batch_values.resize(count);
+
+				for (exint i = 0; i < count; i++)
+				{
+					COMPLEX fractalCoords = coords[batch[i]];
+					real[i] = fractalCoords.real();
+					imag[i] = fractalCoords.imag();
+				}
+
+				// Continue each pixel's orbit from the previous cook, holding
+				// the tile's states while they're iterated.
+				if (orbit_tile)
+				{
+					UT_AutoLock lock_orbits(orbit_tile->lock);
+
+					resume_states.resize(count);
+					for (exint i = 0; i < count; i++)
+						resume_states[i] = orbit_tile->states[batch[i]];
+
+					FractalBatchInfo results;
+					results.num_iter = batch_iter.data();
+					results.smooth = batch_values.data();
+					data->fractal.calculate_resume_batch(real.data(),
+						imag.data(), count, resume_states.data(), results);
+
+					for (exint i = 0; i < count; i++)
+					{
+						orbit_tile->states[batch[i]] = resume_states[i];
+						num_iter[batch[i]] = batch_iter[i];
+						values[batch[i]] = batch_values[i];
+					}
+					return;
+				}
+
+				// Distance estimates track dz/dc, which only the scalar
+				// kernels do.
+				if (distance_mode)
+				{
+					for (exint i = 0; i < count; i++)
+					{
+						FractalCoordsInfo pixelInfo =
+							data->fractal.calculate_distance(
+								COMPLEX(real[i], imag[i]));
+						batch_iter[i] = pixelInfo.num_iter;
+						batch_values[i] = pixelInfo.distance;
+					}
+				}
+				// Calculate the whole batch at once, vectorized where the
+				// CPU and exponent allow it.
+				else
+				{
+					FractalBatchInfo results;
+					results.num_iter = batch_iter.data();
+					if (smooth_mode)
+						results.smooth = batch_values.data();
+
+					data->fractal.calculate_batch(
+						real.data(), imag.data(), count, results, precision);
+				}
+
+				for (exint i = 0; i < count; i++)
+				{
+					num_iter[batch[i]] = batch_iter[i];
+					values[batch[i]] = batch_values[i];
+				}
+			};
+
+			// Whether every pixel has its own sample.
+			bool complete{ true };
+
+			// Trace uniform regions, or calculate the whole tile at once.
+			if (data->trace)
+			{
+				trace_tile(size_x, size_y,
+					data->mode == MandelbrotMode::RAW,
+					num_iter, values, calculate_pixels);
+			}
+			// Or refine it coarse to fine, until the cook's deadline,
+			// continuing from the last cook's samples.
+			else if (data->progressive)
+			{
+				complete = refine_progressive_tile(
+					this, data->refining, data->deadline, progressive_cache,
+					tileList->myX1, tileList->myY1, size_x, size_y,
+					samples, calculate_pixels);
 			}
-			else // Other image planes, black.
+			else
+			{
+				pixels.resize(num_pixels);
+				std::iota(pixels.begin(), pixels.end(), 0);
+				calculate_pixels(pixels);
+			}
+
+			data->shade(*data, num_iter.data(), values.data(), num_pixels, dest);
+
+			// Calculates shaded samples at image pixel coordinates, in the
+			// tile's precision.
+			auto sample_pixels = [&](
+				const std::vector<COMPLEX>& coords,
+				std::vector<fpreal32>& samples)
+			{
+				exint count = coords.size();
+				real.resize(count);
+				imag.resize(count);
+				batch_iter.resize(count);
+				batch_values.resize(count);
+
+				if (precision == Precision::DOUBLE_DOUBLE && !distance_mode)
+				{
+					for (exint i = 0; i < count; i++)
+					{
+						FractalCoordsInfo pixelInfo = data->fractal.calculate_dd(
+							data->space.get_fractal_coords_dd(coords[i]));
+						batch_iter[i] = pixelInfo.num_iter;
+						batch_values[i] = pixelInfo.smooth;
+					}
+
+					data->shade(*data, batch_iter.data(), batch_values.data(),
+						count, samples.data());
+					return;
+				}
+
+				for (exint i = 0; i < count; i++)
+				{
+					COMPLEX fractalCoords = data->space.get_fractal_coords(
+						coords[i]);
+					real[i] = fractalCoords.real();
+					imag[i] = fractalCoords.imag();
+				}
+
+				if (distance_mode)
+				{
+					for (exint i = 0; i < count; i++)
+					{
+						FractalCoordsInfo pixelInfo =
+							data->fractal.calculate_distance(
+								COMPLEX(real[i], imag[i]));
+						batch_iter[i] = pixelInfo.num_iter;
+						batch_values[i] = pixelInfo.distance;
+					}
+				}
+				else
+				{
+					FractalBatchInfo results;
+					results.num_iter = batch_iter.data();
+					if (smooth_mode)
+						results.smooth = batch_values.data();
+
+					data->fractal.calculate_batch(
+						real.data(), imag.data(), count, results,
+						precision == Precision::SINGLE ?
+						Precision::SINGLE : Precision::DOUBLE);
+				}
+
+				data->shade(*data, batch_iter.data(), batch_values.data(),
+					count, samples.data());
+			};
+
+			// Blackholed samples shade to a single value, which isn't
+			// averaged with escaped samples.
+			fpreal32 blackhole{ 0.0f };
+			if (data->fractal.data.blackhole)
+			{
+				int hole_iter{ -1 };
+				fpreal64 hole_value{ -1.0 };
+				data->shade(*data, &hole_iter, &hole_value, 1, &blackhole);
+			}
+
+			if (complete && !data->deep.is_enabled())
+				antialias_tile(
+					tileList, tile, data->antialias, dest, sample_pixels,
+					data->fractal.data.blackhole ? &blackhole : nullptr);
+		}
+		else // Other image planes, black.
+		{
+			for (exint i = 0; i < num_pixels; i++)
 				dest[i] = 0.0f;
 		}
 
@@ -189,6 +1056,34 @@ CC::COP2_Mandelbrot::generateTile(
 	return error();
 }
 
+bool
+CC::COP2_Mandelbrot::updateParmsFlags()
+{
+	fpreal t = CHgetEvalTime();
+	bool deepZoom = evalInt(DEEPZOOM_NAME.first, 0, t);
+
+	// Call parent's updateParmFlags to avoid recursion.
+	bool changed = COP2_Generator::updateParmsFlags();
+
+	changed |= enableParm(DEEPCENTER_NAME.first, deepZoom);
+	changed |= enableParm(DEEPSCALE_NAME.first, deepZoom);
+	changed |= enableParm(DEEPSERIES_NAME.first, deepZoom);
+
+	bool distance = evalInt(nameMode.getToken(), 0, t) ==
+		static_cast<int>(MandelbrotMode::DISTANCE) ||
+		evalInt(namePlanes[DISTANCE_PLANE].getToken(), 0, t);
+	changed |= enableParm(nameDistCutoff.getToken(), distance);
+	changed |= enableParm(nameDistCutoffPixels.getToken(),
+		distance && evalInt(nameDistCutoff.getToken(), 0, t));
+
+	changed |= enableParm(nameStripeDensity.getToken(),
+		evalInt(namePlanes[STRIPE_PLANE].getToken(), 0, t));
+	changed |= enableParm(nameTrapPoint.getToken(),
+		evalInt(namePlanes[TRAP_PLANE].getToken(), 0, t));
+
+	return changed;
+}
+
 /// Destructor
 CC::COP2_Mandelbrot::~COP2_Mandelbrot() {}
 
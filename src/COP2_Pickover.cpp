@@ -8,8 +8,12 @@
 // HDK
 #include <CH/CH_Manager.h>
 
+// STL
+#include <algorithm>
+#include <vector>
+
 /** Parm Switcher used by this interface to generate default generator parms */
-COP_GENERATOR_SWITCHER(15, "Fractal");
+COP_GENERATOR_SWITCHER(28, "Fractal");
 
 
 CC::COP2_Pickover::COP2_Pickover(
@@ -23,9 +27,12 @@ CC::COP2_Pickover::myTemplateList[]
 {
 	TEMPLATE_SWITCHER,
 	TEMPLATES_XFORM_MULTI,
+	TEMPLATES_DEEPZOOM,
 	PRM_Template(PRM_SEPARATOR, TOOL_PARM, 1, &nameSepA),
 	TEMPLATES_MANDELBROT,
 	TEMPLATES_PICKOVER,
+	TEMPLATES_PROGRESSIVE,
+	TEMPLATES_ANTIALIAS,
 	PRM_Template()
 };
 
@@ -80,11 +87,37 @@ CC::COP2_Pickover::newContextData
 	// Stash Pickover fractal data
 	PickoverStashData pickoverData;
 	pickoverData.evalArgs(this, t);
+	pickoverData.fit_period_tolerance(std::abs(data->space.get_step_x()));
 	data->fractal = Pickover(pickoverData);
 
+	// Stash deep zoom data, iterating the frame's reference orbit.
+	DeepZoomStashData deepData;
+	deepData.evalArgs(this, t);
+	data->deep = DeepZoom(deepData, pickoverData, image_sizex, image_sizey);
+
 	// Set the world point for the pickover
-	data->world_point = data->space.get_pixel_coords(
-		data->fractal.data.popoint);
+	if (data->deep.is_enabled())
+		data->world_point = data->deep.get_pixel_coords(
+			data->fractal.data.popoint);
+	else
+		data->world_point = data->space.get_pixel_coords(
+			data->fractal.data.popoint);
+
+	// The deadline starts with the cook.
+	ProgressiveStashData progressiveData;
+	progressiveData.evalArgs(this, t);
+	data->progressive = progressiveData.enable;
+	data->deadline = CookDeadline(progressiveData.budget);
+
+	// Tiles left coarse by the last cook are refined from where they
+	// stopped, as long as nothing changed since.
+	if (data->progressive)
+		progressive_cache.set_key(
+			ProgressiveKey(this, t, image_sizex, image_sizey));
+	else
+		progressive_cache.clear();
+
+	data->antialias.evalArgs(this, t);
 
 	return data;
 }
@@ -107,51 +140,77 @@ CC::COP2_Pickover::generateTile(
 
 	// Forward declaring values
 	int size_x, size_y;
-	exint i;  // Huge because number of pixels may be crazy
-	WORLDPIXELCOORDS worldPixel;
-	COMPLEX fractalCoords;
+	exint num_pixels;  // Huge because number of pixels may be crazy
+
+	// Deep zoom pixels, as offsets from the view center.
+	std::vector<COMPLEX> deltas;
+	std::vector<FractalCoordsInfo> infos;
 
 	// For each pixel in tile...
 	FOR_EACH_UNCOOKED_TILE(tileList, tile, tileIndex)
 	{
 		tile->getSize(size_x, size_y);
+		num_pixels = size_x * size_y;
+
 		// Cook the fractal for the first channel always, and the second
 		// 'reference' channel if data.poref is on.
 		// But don't cook the fractal in unnecessary image planes
 
-		for (exint i = 0; i < size_x * size_y; i++)
+		if (tileIndex == 0 && data->deep.is_enabled())
+		{
+			// Perturb each pixel around the frame's reference orbit.
+			deltas.resize(num_pixels);
+			infos.resize(num_pixels);
+
+			for (exint i = 0; i < num_pixels; i++)
+				deltas[i] = data->deep.get_delta(
+					CC::calculate_world_pixel(tileList, tile, i));
+
+			data->deep.calculate(
+				deltas.data(), num_pixels, data->fractal, infos.data());
+
+			for (exint i = 0; i < num_pixels; i++)
+				dest[i] = infos[i].smooth;
+		}
+		else if (tileIndex == 0)
+		{
+			calculate_smooth_tile(this, data->fractal, data->space,
+				data->antialias,
+				data->progressive ? &progressive_cache : nullptr,
+				data->deadline, data->refining, tileList, tile, dest);
+		}
+		else
 		{
-			//First check to see if this frame should be cooked
-			// If index is greater than one, or is one but reference isn't on
-			// Assign black
-			if (tileIndex > 1 || (tileIndex == 1 && !data->fractal.data.poref))
-				dest[i] = 0.0f;
-			else
+			for (exint i = 0; i < num_pixels; i++)
 			{
+				//First check to see if this frame should be cooked
+				// If index is greater than one, or is one but reference isn't
+				// on, assign black
+				if (tileIndex > 1 ||
+					(tileIndex == 1 && !data->fractal.data.poref))
+				{
+					dest[i] = 0.0f;
+					continue;
+				}
+
 				// Get the 'world pixel coords from tile.
 				WORLDPIXELCOORDS worldPixel = CC::calculate_world_pixel(
 					tileList, tile, i);
+
 				// Convert those to 'fractal space'
-				COMPLEX fractalCoords = data->space.get_fractal_coords(
-					worldPixel);
-				FractalCoordsInfo pixelInfo = data->fractal.calculate(
-					fractalCoords);
+				COMPLEX fractalCoords;
+				if (data->deep.is_enabled())
+					fractalCoords = data->deep.get_fractal_coords(
+						data->deep.get_delta(worldPixel));
+				else
+					fractalCoords = data->space.get_fractal_coords(worldPixel);
 
-				// Write the main pickover fractal
-				if (tileIndex == 0)  // Main Fractal
-				{
-					dest[i] = pixelInfo.smooth;
-				}
 				// Write the reference fractal
-				else if (tileIndex == 1 && data->fractal.data.poref)
-				{
-					dest[i] = data->calculate_reference(
-						fractalCoords,
-						worldPixel);
-				}
+				dest[i] = data->calculate_reference(
+					fractalCoords,
+					worldPixel);
 			}
 		}
-;
 
 		writeFPtoTile(tileList, dest, tileIndex);
 	};
@@ -168,6 +227,7 @@ CC::COP2_Pickover::updateParmsFlags()
 	fpreal t = CHgetEvalTime();
 	bool modeRotate = evalInt(namePoMode.getToken(), 0, t);
 	bool modePoRef = evalInt(POREFERENCE_NAME.first, 0, t);
+	bool deepZoom = evalInt(DEEPZOOM_NAME.first, 0, t);
 
 	// Set variables for hiding
 	bool displayRotate{ false };
@@ -184,6 +244,9 @@ CC::COP2_Pickover::updateParmsFlags()
 
 	changed |= setVisibleState(namePoLineRotate.getToken(), displayRotate);
 	changed |= setVisibleState(POREFSIZE_NAME.first, displayPoRefSize);
+	changed |= enableParm(DEEPCENTER_NAME.first, deepZoom);
+	changed |= enableParm(DEEPSCALE_NAME.first, deepZoom);
+	changed |= enableParm(DEEPSERIES_NAME.first, deepZoom);
 
 	return changed;
 }
@@ -0,0 +1,532 @@
+/** \file DeepZoom.cpp
+	Source defining the perturbation engine used for deep zooms.
+ */
+
+ // Local
+#include "DeepZoom.h"
+
+// STL
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
+
+namespace
+{
+/**Squared Pauldelbrot glitch criterion. A pixel whose orbit is this much
+ * closer to zero than the reference's has lost the precision of its offset.*/
+const fpreal GLITCH_TOLERANCE_SQ{ 1e-6 };
+
+/**Largest cubic series term, relative to the linear term, that is still
+ * negligible next to double precision rounding.*/
+const fpreal SERIES_TOLERANCE{ 1e-12 };
+
+/**Returns (Z + d)^N - Z^N without the cancellation of evaluating it
+ * directly, by expanding it as sum(binomial(N, k) Z^(N-k) d^k) for k = 1..N
+ * with Horner's method in d.*/
+template <int N>
+inline COMPLEX
+perturb_pow(const COMPLEX& Z, const COMPLEX& d)
+{
+	COMPLEX sum{ 1.0 };
+	COMPLEX z_pow{ 1.0 };
+	fpreal binomial{ 1.0 };
+
+	for (int k = N - 1; k >= 1; --k)
+	{
+		z_pow = CC::complex_mult(z_pow, Z);
+		binomial = binomial * (k + 1) / (N - k);
+		sum = CC::complex_mult(sum, d) + binomial * z_pow;
+	}
+
+	return CC::complex_mult(sum, d);
+}
+
+/**Returns whether the reference step Z is past the bailout while the pixel
+ * offset from it by d isn't.*/
+inline bool
+escaped_before(const COMPLEX& Z, const COMPLEX& d, fpreal bailout_sq)
+{
+	return std::norm(Z) > bailout_sq && std::norm(Z + d) <= bailout_sq;
+}
+
+/**Perturbs a single pixel around an orbit, writing the result the visitor
+ * builds. Returns false, with how glitched it was in 'glitch', when the
+ * pixel needs a different reference.*/
+template <int N, typename Visitor>
+bool
+perturb_pixel(
+	const CC::ReferenceOrbit& orbit,
+	const CC::MandelbrotStashData& data,
+	COMPLEX dc,
+	Visitor& visitor,
+	CC::FractalCoordsInfo& result,
+	fpreal& glitch)
+{
+	const int steps = data.jdepth + 1;
+	const fpreal bailout_sq = data.bailout * data.bailout;
+
+	COMPLEX d{ 0 };
+	COMPLEX z{ 0 };
+	COMPLEX dz{ 0 };
+	int iterations{ 0 };
+
+	// Jump straight past the iterations the series approximation covers.
+	if (orbit.skip > 0)
+	{
+		COMPLEX u = dc / orbit.series_radius;
+		d = CC::complex_mult(u, orbit.series_a + CC::complex_mult(
+			u, orbit.series_b + CC::complex_mult(u, orbit.series_c)));
+		iterations = orbit.skip;
+		z = orbit.z[iterations * steps - 1] + d;
+
+		// dz/dc of the series, A + 2Bu + 3Cu^2 unscaled.
+		if (Visitor::DERIVATIVE)
+			dz = (orbit.series_a + CC::complex_mult(u,
+				2.0 * orbit.series_b + 3.0 * CC::complex_mult(
+					u, orbit.series_c))) / orbit.series_radius;
+	}
+
+	visitor.start(iterations);
+
+	bool glitched{ false };
+	while (iterations < data.iters)
+	{
+		// The reference escaped before this pixel did.
+		if (iterations >= orbit.length)
+		{
+			glitched = true;
+			glitch = 1.0;
+			break;
+		}
+
+		const COMPLEX* Z = &orbit.z[iterations * steps];
+		COMPLEX z_in = iterations ? Z[-1] : COMPLEX(0);
+
+		// dz/dc doesn't need perturbing, it's iterated on the full z.
+		if (Visitor::DERIVATIVE)
+		{
+			dz = CC::complex_mult(
+				static_cast<fpreal>(N) * CC::ipow<N - 1>(z_in + d), dz) + 1.0;
+		}
+
+		// The reference can escape partway through its last iteration. A
+		// pixel still inside the bailout there has an offset as large as the
+		// reference, and would seem to escape with it.
+		const bool last = iterations + 1 == orbit.length;
+
+		// d' = (Z + d)^N - Z^N + dc, and the Julia steps, whose offsets
+		// cancel out.
+		d = perturb_pow<N>(z_in, d) + dc;
+		bool behind = last && escaped_before(Z[0], d, bailout_sq);
+		for (int julia = 1; julia < steps && !behind; julia++)
+		{
+			if (Visitor::DERIVATIVE)
+				dz = CC::complex_mult(static_cast<fpreal>(N) *
+					CC::ipow<N - 1>(Z[julia - 1] + d), dz);
+
+			d = perturb_pow<N>(Z[julia - 1], d);
+			behind = last && escaped_before(Z[julia], d, bailout_sq);
+		}
+
+		if (behind)
+		{
+			glitched = true;
+			glitch = 1.0;
+			break;
+		}
+
+		COMPLEX z_ref = Z[steps - 1];
+		z = z_ref + d;
+
+		fpreal norm = std::norm(z);
+		fpreal norm_ref = std::norm(z_ref);
+		if (norm < GLITCH_TOLERANCE_SQ * norm_ref)
+		{
+			glitched = true;
+			glitch = norm / norm_ref;
+			break;
+		}
+
+		visitor.visit(z, dz);
+
+		// Julia steps past the bailout can overflow into NaN, which only
+		// escaping orbits reach.
+		if (norm > bailout_sq || std::isnan(norm))
+			break;
+
+		++iterations;
+	}
+
+	result = visitor.finish(iterations, z, dz);
+	return !glitched;
+}
+
+/**Accumulates the smooth value of Mandelbrot::calculate, and when Distance
+ * is set the distance estimate of Mandelbrot::calculate_distance. Normalized
+ * smoothing is calculated from the final z alone.*/
+template <bool Distance>
+struct MandelbrotVisitor
+{
+	static const bool DERIVATIVE{ Distance };
+
+	const CC::MandelbrotStashData& data;
+	const CC::ReferenceOrbit& reference;
+	fpreal smooth{ 1.0 };
+
+	bool exponential;
+	fpreal log_bailout, log_degree;
+
+	MandelbrotVisitor(
+		const CC::MandelbrotStashData& data,
+		const CC::ReferenceOrbit& reference) :
+		data(data), reference(reference),
+		exponential(data.smoothing == CC::SmoothingMode::EXPONENTIAL),
+		log_bailout(std::log(data.bailout)),
+		log_degree((data.jdepth + 1) * std::log(std::abs(data.power))) {}
+
+	void start(int skip)
+	{
+		// Skipped iterations stay within 1e-3 of the reference orbit, whose
+		// smooth sum is close enough.
+		smooth = skip ? reference.smooth[skip] : 1.0;
+	}
+
+	void visit(COMPLEX z, COMPLEX dz)
+	{
+		if (exponential)
+			smooth += exp(-abs(-z));
+	}
+
+	CC::FractalCoordsInfo finish(int iterations, COMPLEX z, COMPLEX dz)
+	{
+		if (data.smoothing == CC::SmoothingMode::NORMALIZED)
+			smooth = CC::normalized_iterations(
+				iterations, data.iters, z, log_bailout, log_degree);
+		else if (data.smoothing == CC::SmoothingMode::NONE)
+			smooth = 0.0;
+
+		if (iterations == data.iters)
+		{
+			if (data.blackhole)
+				return CC::FractalCoordsInfo(-1, z, -1.0);
+			return CC::FractalCoordsInfo(iterations, z, smooth);
+		}
+
+		// The reference orbit ends at the bailout, so the estimate is taken
+		// there rather than settled as in Mandelbrot::calculate_distance.
+		fpreal distance = Distance ? CC::distance_estimate(z, dz) : 0.0;
+		return CC::FractalCoordsInfo(iterations, z, smooth, distance);
+	}
+};
+
+/**Accumulates the minimum distance of Pickover::calculate.*/
+struct PickoverVisitor
+{
+	static const bool DERIVATIVE{ false };
+
+	CC::Pickover& fractal;
+	fpreal skipped_distance{ 1e10 };
+	fpreal distance{ 1e10 };
+
+	PickoverVisitor(CC::Pickover& fractal) : fractal(fractal) {}
+
+	fpreal measure(COMPLEX z)
+	{
+		if (fractal.data.pomode == 0)
+			return fractal.distance_to_point(z, fractal.data.popoint);
+
+		return fractal.distance_to_line(
+			z, fractal.data.popoint, fractal.data.porotate);
+	}
+
+	void start(int skip)
+	{
+		distance = skip ? skipped_distance : 1e10;
+	}
+
+	void visit(COMPLEX z, COMPLEX dz)
+	{
+		distance = SYSmin(distance, measure(z));
+	}
+
+	CC::FractalCoordsInfo finish(int iterations, COMPLEX z, COMPLEX dz)
+	{
+		return CC::FractalCoordsInfo(0, 0, distance);
+	}
+};
+}  // End of anonymous Namespace
+
+CC::DeepZoom::DeepZoom(
+	const DeepZoomStashData& deepData,
+	const MandelbrotStashData& fractalData,
+	int image_x,
+	int image_y) :
+	data(fractalData), image_x(image_x), image_y(image_y)
+{
+	power = data.get_kernel_power();
+	enabled = deepData.enable && power != 0 && image_x > 0;
+
+	if (!enabled)
+		return;
+
+	// The scale is the width of the image, which always fits in a double.
+	fpreal64 scale = std::strtod(deepData.scale.c_str(), nullptr);
+	if (!(scale > 0.0))
+		scale = 1.0;
+
+	spacing = scale / image_x;
+
+	int limbs = BigFixed::limbs_for_spacing(spacing);
+	center = BigComplex(
+		BigFixed::from_string(deepData.center_x, limbs),
+		BigFixed::from_string(deepData.center_y, limbs));
+
+	// The series is fitted to the farthest pixel from the center.
+	fpreal radius{ 0.0 };
+	if (deepData.series)
+		radius = 0.5 * spacing * std::hypot(image_x, image_y);
+
+	calculate_reference(COMPLEX(0), radius, reference);
+}
+
+bool
+CC::DeepZoom::is_enabled() const
+{
+	return enabled;
+}
+
+COMPLEX
+CC::DeepZoom::get_delta(WORLDPIXELCOORDS pixel_coords) const
+{
+	return COMPLEX(
+		(pixel_coords.first - 0.5 * image_x) * spacing,
+		(pixel_coords.second - 0.5 * image_y) * spacing);
+}
+
+COMPLEX
+CC::DeepZoom::get_fractal_coords(COMPLEX delta) const
+{
+	return center.to_complex() + delta;
+}
+
+WORLDPIXELCOORDS
+CC::DeepZoom::get_pixel_coords(COMPLEX fractal_coords) const
+{
+	COMPLEX delta = (fractal_coords - center.to_complex()) / spacing;
+	return WORLDPIXELCOORDS(
+		static_cast<int>(std::floor(delta.real() + 0.5 * image_x + 0.5)),
+		static_cast<int>(std::floor(delta.imag() + 0.5 * image_y + 0.5)));
+}
+
+void
+CC::DeepZoom::calculate_reference(
+	COMPLEX offset, fpreal series_radius, ReferenceOrbit& orbit) const
+{
+	const int limbs = center.real.get_limbs();
+	const int steps = data.jdepth + 1;
+	const fpreal bailout_sq = data.bailout * data.bailout;
+
+	BigComplex c = center + BigComplex::from_complex(offset, limbs);
+	BigComplex joffset = BigComplex::from_complex(data.joffset, limbs);
+	BigComplex z(limbs);
+	bool escaped{ false };
+
+	// Takes one step of the formula. Once the orbit has escaped, or would
+	// outgrow the integer limbs, the rest of its iteration is taken in double
+	// precision from the last stored z, as the regular kernels would.
+	auto step = [&](const BigComplex& add)
+	{
+		COMPLEX add_ref = add.to_complex();
+		COMPLEX z_ref = escaped ? orbit.z.back() : z.to_complex();
+
+		if (!escaped && std::pow(abs(z_ref), power) + abs(add_ref) <
+			BIGFIXED_INT_LIMIT)
+		{
+			z = z.pow(power) + add;
+			z_ref = z.to_complex();
+			escaped = std::norm(z_ref) > bailout_sq;
+		}
+		else
+		{
+			escaped = true;
+			COMPLEX base = z_ref;
+			for (int i = 1; i < power; i++)
+				z_ref = complex_mult(z_ref, base);
+			z_ref += add_ref;
+		}
+
+		orbit.z.push_back(z_ref);
+	};
+
+	orbit.z.clear();
+	orbit.z.reserve(static_cast<size_t>(SYSmax(data.iters, 0)) * steps);
+	orbit.smooth.assign(1, 1.0);
+	orbit.length = 0;
+	orbit.skip = 0;
+	orbit.series_radius = series_radius;
+
+	// The series recurrences are only derived for z^2 + c.
+	bool fitting = series_radius > 0.0 && power == 2 && data.jdepth == 0;
+	COMPLEX a{ 0 }, b{ 0 }, cubic{ 0 };
+	COMPLEX z_prev{ 0 };
+
+	for (int n = 0; n < data.iters; n++)
+	{
+		if (fitting)
+		{
+			// A' = 2ZA + 1, B' = 2ZB + A^2, C' = 2ZC + 2AB, each scaled by
+			// the matching power of the radius.
+			COMPLEX two_z = 2.0 * z_prev;
+			COMPLEX next_a = complex_mult(two_z, a) + series_radius;
+			COMPLEX next_b = complex_mult(two_z, b) + complex_mult(a, a);
+			COMPLEX next_c = complex_mult(two_z, cubic) +
+				2.0 * complex_mult(a, b);
+			a = next_a;
+			b = next_b;
+			cubic = next_c;
+		}
+
+		// Julia steps raise an escaping z to the power many times over
+		// before the iteration ends, so each step checks the bailout.
+		step(c);
+		for (int julia = 0; julia < data.jdepth; julia++)
+			step(joffset);
+
+		COMPLEX z_ref = orbit.z.back();
+		orbit.smooth.push_back(orbit.smooth.back() + exp(-abs(-z_ref)));
+		orbit.length = n + 1;
+
+		if (fitting)
+		{
+			// Skipping is safe while the cubic term is negligible, while
+			// every pixel stays far enough from the reference that none can
+			// glitch unseen, and while none can have escaped.
+			fpreal z_abs = abs(z_ref);
+			fpreal spread = abs(a) + abs(b) + abs(cubic);
+
+			if (abs(cubic) <= SERIES_TOLERANCE * abs(a) &&
+				spread < 1e-3 * z_abs && z_abs + spread < data.bailout)
+			{
+				orbit.skip = n + 1;
+				orbit.series_a = a;
+				orbit.series_b = b;
+				orbit.series_c = cubic;
+			}
+			else
+			{
+				fitting = false;
+			}
+		}
+
+		z_prev = z_ref;
+
+		if (escaped)
+			break;
+	}
+}
+
+template <int N, typename Visitor>
+void
+CC::DeepZoom::calculate_batch(
+	const COMPLEX* deltas, exint size, Visitor& visitor,
+	FractalCoordsInfo* results) const
+{
+	std::vector<exint> pending(size);
+	std::iota(pending.begin(), pending.end(), 0);
+	std::vector<fpreal> glitch(size, 1.0);
+
+	const ReferenceOrbit* orbit = &reference;
+	ReferenceOrbit rereference;
+	COMPLEX orbit_offset{ 0 };
+
+	for (int r = 0; r < DEEPZOOM_MAX_REFERENCES && !pending.empty(); r++)
+	{
+		// Re-reference at the worst glitched pixel, which lies nearest the
+		// center of its glitch and fixes most of its neighbours with it.
+		if (r > 0)
+		{
+			exint worst = pending[0];
+			for (exint i : pending)
+				if (glitch[i] < glitch[worst])
+					worst = i;
+
+			orbit_offset = deltas[worst];
+			calculate_reference(orbit_offset, 0.0, rereference);
+			orbit = &rereference;
+		}
+
+		std::vector<exint> glitched;
+		for (exint i : pending)
+		{
+			if (!perturb_pixel<N>(*orbit, data, deltas[i] - orbit_offset,
+				visitor, results[i], glitch[i]))
+				glitched.push_back(i);
+		}
+
+		pending.swap(glitched);
+	}
+}
+
+void
+CC::DeepZoom::calculate(
+	const COMPLEX* deltas, exint size, FractalCoordsInfo* results) const
+{
+	MandelbrotVisitor<false> visitor(data, reference);
+
+	switch (power)
+	{
+	case 2: calculate_batch<2>(deltas, size, visitor, results); break;
+	case 3: calculate_batch<3>(deltas, size, visitor, results); break;
+	case 4: calculate_batch<4>(deltas, size, visitor, results); break;
+	case 5: calculate_batch<5>(deltas, size, visitor, results); break;
+	case 6: calculate_batch<6>(deltas, size, visitor, results); break;
+	case 7: calculate_batch<7>(deltas, size, visitor, results); break;
+	case 8: calculate_batch<8>(deltas, size, visitor, results); break;
+	default: break;
+	}
+}
+
+void
+CC::DeepZoom::calculate_distance(
+	const COMPLEX* deltas, exint size, FractalCoordsInfo* results) const
+{
+	MandelbrotVisitor<true> visitor(data, reference);
+
+	switch (power)
+	{
+	case 2: calculate_batch<2>(deltas, size, visitor, results); break;
+	case 3: calculate_batch<3>(deltas, size, visitor, results); break;
+	case 4: calculate_batch<4>(deltas, size, visitor, results); break;
+	case 5: calculate_batch<5>(deltas, size, visitor, results); break;
+	case 6: calculate_batch<6>(deltas, size, visitor, results); break;
+	case 7: calculate_batch<7>(deltas, size, visitor, results); break;
+	case 8: calculate_batch<8>(deltas, size, visitor, results); break;
+	default: break;
+	}
+}
+
+void
+CC::DeepZoom::calculate(
+	const COMPLEX* deltas, exint size, Pickover& fractal,
+	FractalCoordsInfo* results) const
+{
+	PickoverVisitor visitor(fractal);
+
+	// Distances of the skipped iterations, measured on the reference.
+	const int steps = data.jdepth + 1;
+	for (int n = 0; n < reference.skip; n++)
+		visitor.skipped_distance = SYSmin(visitor.skipped_distance,
+			visitor.measure(reference.z[(n + 1) * steps - 1]));
+
+	switch (power)
+	{
+	case 2: calculate_batch<2>(deltas, size, visitor, results); break;
+	case 3: calculate_batch<3>(deltas, size, visitor, results); break;
+	case 4: calculate_batch<4>(deltas, size, visitor, results); break;
+	case 5: calculate_batch<5>(deltas, size, visitor, results); break;
+	case 6: calculate_batch<6>(deltas, size, visitor, results); break;
+	case 7: calculate_batch<7>(deltas, size, visitor, results); break;
+	case 8: calculate_batch<8>(deltas, size, visitor, results); break;
+	default: break;
+	}
+}
@@ -8,6 +8,10 @@
  // Local
 #include "FractalSpace.h"
 
+// STL
+#include <cmath>
+#include <limits>
+
 // HDK
 #include <sys/SYS_Math.h>
 
@@ -51,13 +55,11 @@ CC::calculate_world_pixel(
 	// while sizes from getSize() are correct
 	tile->getSize(tile_x, tile_y);
 
-	int x, y;
-	// Base X pos for the tile, plus the X progression of the plane.
-	x = tiles->myX1 + (pixel_index % tile_x);
-
-	// Divide the pixel index into the size of x rounded down
-	// For the tile's y, and add the base Y pos.
-	y = SYSfloor((fpreal)pixel_index / tile_x) + (tiles->myY1);
+	// The row is the index divided by the width, rounded down, and the
+	// column what remains.
+	int row = pixel_index / tile_x;
+	int x = tiles->myX1 + (pixel_index - row * tile_x);
+	int y = tiles->myY1 + row;
 	return std::pair<int, int>(x, y);
 }
 
@@ -69,9 +71,33 @@ CC::FractalSpace::FractalSpace()
 
 CC::FractalSpace::FractalSpace(int x, int y)
 {
+	post_matrix.identity();
 	set_image_size(x, y);
 }
 
+void
+CC::FractalSpace::update_mapping()
+{
+	// The pixel's translation in _get_fractal_coords gives the row
+	// (x, y, 1) / image_x, which post_matrix carries to fractal space.
+	fpreal scale = image_x ? 1.0 / (fpreal)image_x : 0.0;
+	origin = COMPLEX(post_matrix(2, 0), post_matrix(2, 1));
+	step_x = COMPLEX(post_matrix(0, 0) * scale, post_matrix(0, 1) * scale);
+	step_y = COMPLEX(post_matrix(1, 0) * scale, post_matrix(1, 1) * scale);
+
+	// Invert the 2x2 matrix whose columns are the steps. A degenerate xform,
+	// such as a scale of zero, maps every coordinate outside the image.
+	fpreal det = step_x.real() * step_y.imag() - step_y.real() * step_x.imag();
+	if (det == 0.0)
+	{
+		const fpreal nan = std::numeric_limits<fpreal>::quiet_NaN();
+		inverse_x = inverse_y = COMPLEX(nan, nan);
+		return;
+	}
+	inverse_x = COMPLEX(step_y.imag() / det, -step_y.real() / det);
+	inverse_y = COMPLEX(-step_x.imag() / det, step_x.real() / det);
+}
+
 void
 CC::FractalSpace::set_xform(MultiXformStashData & xdata)
 {
@@ -120,6 +146,7 @@ CC::FractalSpace::set_xform(MultiXformStashData & xdata)
 
 	// Apply our resolved xform to the node's viewer xform
 	post_matrix = m;
+	update_mapping();
 }
 
 void
@@ -132,33 +159,29 @@ CC::FractalSpace::set_xform(XformStashData& xformData)
 		xdata.offset_x, xdata.offset_y,
 		xdata.rotate,
 		xdata.scale, xdata.scale);
+	update_mapping();
 }
 
 void
 CC::FractalSpace::set_xform(UT_Matrix3D & xform)
 {
 	post_matrix = xform;
+	update_mapping();
 }
 
 COMPLEX
-CC::FractalSpace::_get_fractal_coords(COMPLEX pixel_coords)
+CC::FractalSpace::_get_fractal_coords(COMPLEX pixel_coords) const
 {
-	COMPLEX fc{
-		pixel_coords.real() / (fpreal)image_x,
-		pixel_coords.imag() / (fpreal)image_x };
-	UT_Matrix3D m;
-	m.identity();
-	m.xform(xdata.xord, fc.real(), fc.imag());
-
-	m *= post_matrix;
-
-	fc = { m(2, 0), m(2, 1) };  // Matrix(row, col) xz, yz.
-
-	return fc;
+	// Summed in the same order as TileCoords, so both agree exactly.
+	fpreal x = pixel_coords.real();
+	fpreal y = pixel_coords.imag();
+	return COMPLEX(
+		(origin.real() + y * step_y.real()) + x * step_x.real(),
+		(origin.imag() + y * step_y.imag()) + x * step_x.imag());
 }
 
 COMPLEX
-CC::FractalSpace::get_fractal_coords(WORLDPIXELCOORDS pixel_coords)
+CC::FractalSpace::get_fractal_coords(WORLDPIXELCOORDS pixel_coords) const
 {
 	// Cast to fpreal.
 	COMPLEX fpreal_coords{
@@ -168,34 +191,110 @@ CC::FractalSpace::get_fractal_coords(WORLDPIXELCOORDS pixel_coords)
 }
 
 COMPLEX
-CC::FractalSpace::get_fractal_coords(COMPLEX pixel_coords)
+CC::FractalSpace::get_fractal_coords(COMPLEX pixel_coords) const
 {
 	return _get_fractal_coords(pixel_coords);
 }
 
+CC::ComplexDD
+CC::FractalSpace::get_fractal_coords_dd(WORLDPIXELCOORDS pixel_coords)
+{
+	return get_fractal_coords_dd(COMPLEX(
+		(fpreal)pixel_coords.first,
+		(fpreal)pixel_coords.second));
+}
 
-WORLDPIXELCOORDS
-CC::FractalSpace::get_pixel_coords(COMPLEX fractal_coords)
+CC::ComplexDD
+CC::FractalSpace::get_fractal_coords_dd(COMPLEX pixel_coords)
 {
-	UT_Matrix3D m;
-	m.identity();
+	// The offset of a pixel from the origin is tiny at deep zooms, so
+	// summing the two exactly keeps all of its precision.
+	fpreal x = pixel_coords.real();
+	fpreal y = pixel_coords.imag();
 
-	// Set m to fractal coordinates
-	m.xform(xdata.xord, fractal_coords.real(), fractal_coords.imag());
+	fpreal offset_x = x * step_x.real() + y * step_y.real();
+	fpreal offset_y = x * step_x.imag() + y * step_y.imag();
 
-	// Apply our object's transform
-	m.xform(
-		xdata.xord,
-		xdata.offset_x, xdata.offset_y,
-		xdata.rotate,
-		xdata.scale, xdata.scale * (image_y / (fpreal)image_x),
-		0, 0,
-		true);
+	return ComplexDD(
+		two_sum(origin.real(), offset_x),
+		two_sum(origin.imag(), offset_y));
+}
+
+CC::Precision
+CC::FractalSpace::get_precision(WORLDPIXELCOORDS min, WORLDPIXELCOORDS max)
+{
+	fpreal spacing = std::abs(step_x);
+
+	// Orbits of the set stay within |z| <= 2, so views near the origin still
+	// need to resolve pixels against values that large.
+	fpreal magnitude = 2.0;
+	WORLDPIXELCOORDS corners[] = {
+		min, max,
+		WORLDPIXELCOORDS(min.first, max.second),
+		WORLDPIXELCOORDS(max.first, min.second) };
+	for (const WORLDPIXELCOORDS& corner : corners)
+		magnitude = SYSmax(magnitude, std::abs(get_fractal_coords(corner)));
+
+	// Machine epsilon of double, relative to the coordinates.
+	fpreal relative = spacing / magnitude;
+	if (relative > std::ldexp(1.0, PRECISION_HEADROOM_BITS - 53))
+		return Precision::DOUBLE;
+	return Precision::DOUBLE_DOUBLE;
+}
+
+COMPLEX
+CC::FractalSpace::get_image_coords(COMPLEX fractal_coords) const
+{
+	fpreal real = fractal_coords.real() - origin.real();
+	fpreal imag = fractal_coords.imag() - origin.imag();
 
-	int x = static_cast<int>(m(2, 0) * image_x);
-	int y = static_cast<int>(m(2, 1) * image_y);
+	return COMPLEX(
+		inverse_x.real() * real + inverse_x.imag() * imag,
+		inverse_y.real() * real + inverse_y.imag() * imag);
+}
+
+WORLDPIXELCOORDS
+CC::FractalSpace::get_pixel_coords(COMPLEX fractal_coords) const
+{
+	COMPLEX image_coords = get_image_coords(fractal_coords);
+
+	// Pixels are centered on their integer coordinates.
+	return WORLDPIXELCOORDS(
+		static_cast<int>(std::floor(image_coords.real() + 0.5)),
+		static_cast<int>(std::floor(image_coords.imag() + 0.5)));
+}
+
+void
+CC::FractalSpace::get_pixel_indices(
+	const COMPLEX* coords,
+	exint count,
+	int size_x,
+	int size_y,
+	exint* indices) const
+{
+	// std::complex is laid out as two values, real then imaginary, which
+	// keeps the loop free of calls for the compiler to vectorize.
+	const fpreal* values = reinterpret_cast<const fpreal*>(coords);
 
-	return WORLDPIXELCOORDS(x, y);
+	for (exint i = 0; i < count; i++)
+	{
+		fpreal real = values[2 * i] - origin.real();
+		fpreal imag = values[2 * i + 1] - origin.imag();
+
+		fpreal x = std::floor(
+			inverse_x.real() * real + inverse_x.imag() * imag + 0.5);
+		fpreal y = std::floor(
+			inverse_y.real() * real + inverse_y.imag() * imag + 0.5);
+
+		// NaN coordinates fail the comparisons, and only pixels inside the
+		// image are converted to integers.
+		bool inside = x >= 0.0 && x < size_x && y >= 0.0 && y < size_y;
+		x = inside ? x : 0.0;
+		y = inside ? y : 0.0;
+
+		exint index = static_cast<exint>(y) * size_x + static_cast<exint>(x);
+		indices[i] = inside ? index : -1;
+	}
 }
 
 COMPLEX
@@ -216,6 +315,7 @@ CC::FractalSpace::set_image_size(int x, int y)
 {
 	image_x = x;
 	image_y = y;
+	update_mapping();
 }
 
 WORLDPIXELCOORDS
@@ -226,3 +326,32 @@ CC::FractalSpace::get_image_size()
 
 /** Destructor */
 CC::FractalSpace::~FractalSpace() {}
+
+CC::TileCoords::TileCoords(
+	const FractalSpace& space, TIL_TileList* tiles, TIL_Tile* tile)
+{
+	int size_y;
+	tile->getSize(size_x, size_y);
+
+	COMPLEX origin = space.get_origin();
+	COMPLEX step_x = space.get_step_x();
+	COMPLEX step_y = space.get_step_y();
+
+	rows.resize(size_y);
+	for (int y = 0; y < size_y; y++)
+	{
+		fpreal world_y = tiles->myY1 + y;
+		rows[y] = COMPLEX(
+			origin.real() + world_y * step_y.real(),
+			origin.imag() + world_y * step_y.imag());
+	}
+
+	columns.resize(size_x);
+	for (int x = 0; x < size_x; x++)
+	{
+		fpreal world_x = tiles->myX1 + x;
+		columns[x] = COMPLEX(
+			world_x * step_x.real(),
+			world_x * step_x.imag());
+	}
+}
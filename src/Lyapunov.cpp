@@ -13,15 +13,42 @@ CC::Lyapunov::Lyapunov(LyapunovStashData & lyaData)
 CC::FractalCoordsInfo
 CC::Lyapunov::calculate(COMPLEX coords)
 {
-	auto preseq = generate_sequence(coords.real(), coords.imag());
+	std::vector<fpreal> preseq, seq;
+	fpreal value = calculate_value(coords.real(), coords.imag(), preseq, seq);
 
-	std::vector<fpreal> seq;
+	return FractalCoordsInfo(0, 0, value);
+}
+
+void
+CC::Lyapunov::calculate_batch(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	const FractalBatchInfo& results)
+{
+	std::vector<fpreal> preseq, seq;
+
+	for (exint i = 0; i < size; i++)
+	{
+		fpreal value = calculate_value(real[i], imag[i], preseq, seq);
+		results.write(i, FractalCoordsInfo(0, 0, value));
+	}
+}
+
+fpreal
+CC::Lyapunov::calculate_value(
+	fpreal x,
+	fpreal y,
+	std::vector<fpreal>& preseq,
+	std::vector<fpreal>& seq)
+{
+	preseq.resize(data.seq.size());
+	for (int i = 0; i < data.seq.size(); ++i)
+		preseq[i] = SYSlerp(x, y, data.seq[i]);
 
 	int niters = data.iters;
 	if (niters > preseq.size())
 		niters = preseq.size();
 
-	seq.reserve(data.iters + 1);
+	seq.resize(data.iters + 1);
 	seq[0] = data.start;
 
 	for (int i = 1; i <= niters; i++)
@@ -52,7 +79,7 @@ CC::Lyapunov::calculate(COMPLEX coords)
 
 	value /= data.maxval;
 
-	return FractalCoordsInfo(0, 0, value);
+	return value;
 }
 
 std::vector<fpreal>
@@ -5,72 +5,944 @@
 
  // Local
 #include "Mandelbrot.h"
+#include "MandelbrotSIMD.h"
 
 // STL
 #include <complex>
+#include <memory>
 #include <vector>
 
+// HDK
+#include <SYS/SYS_Math.h>
+
+
+namespace
+{
+/**Relative change between successive distance estimates at which an
+ * escaped orbit's estimate is considered settled.*/
+const fpreal DISTANCE_TOLERANCE{ 1e-3 };
+
+/**Squared |z| beyond which the estimate has always settled.*/
+const fpreal DISTANCE_ESCAPE_SQ{ 1e20 };
+
+/**Most iterations run past the bailout while waiting for the estimate to
+ * settle. |z| grows doubly exponentially, so few are ever needed.*/
+const int DISTANCE_MAX_ITERS{ 16 };
+}  // End of anonymous Namespace
+
+CC::Mandelbrot::Mandelbrot()
+{
+	configure();
+}
 
 CC::Mandelbrot::Mandelbrot(MandelbrotStashData& mandelData)
 {
 	data = mandelData;
+	configure();
 }
 
 CC::Mandelbrot::~Mandelbrot() {}
 
+void
+CC::Mandelbrot::configure()
+{
+	kernel_power = data.get_kernel_power();
+	interior_test = data.allows_interior_test();
+	log_bailout = std::log(data.bailout);
+	log_degree = (data.jdepth + 1) * std::log(std::abs(data.power));
+	select_kernels();
+}
+
+void
+CC::Mandelbrot::select_kernels()
+{
+	// Select the kernels specialized for the exponent, rather than paying
+	// for std::pow on every iteration.
+	switch (kernel_power)
+	{
+	case 2: select_kernels_for_power<2>(); break;
+	case 3: select_kernels_for_power<3>(); break;
+	case 4: select_kernels_for_power<4>(); break;
+	case 5: select_kernels_for_power<5>(); break;
+	case 6: select_kernels_for_power<6>(); break;
+	case 7: select_kernels_for_power<7>(); break;
+	case 8: select_kernels_for_power<8>(); break;
+	default: select_kernels_for_power<0>(); break;
+	}
+}
+
+template <int N>
+void
+CC::Mandelbrot::select_kernels_for_power()
+{
+	// The double-double kernels are dominated by their arithmetic, and are
+	// only specialized for the exponent.
+	dd_kernel = &Mandelbrot::calculate_kernel_dd<N>;
+
+	// Shallow Julia depths are unrolled, see MAX_KERNEL_JULIA.
+	switch (data.jdepth)
+	{
+	case 0: select_kernels_for_julia<N, 0>(); break;
+	case 1: select_kernels_for_julia<N, 1>(); break;
+	case 2: select_kernels_for_julia<N, 2>(); break;
+	default: select_kernels_for_julia<N, KERNEL_JULIA_ANY>(); break;
+	}
+}
+
+template <int N, int J>
+void
+CC::Mandelbrot::select_kernels_for_julia()
+{
+	z_kernel = &Mandelbrot::calculate_z_kernel<N, J>;
+	dz_kernel = &Mandelbrot::calculate_z_kernel<N, J>;
+
+	if (data.blackhole)
+	{
+		select_point_kernels<N, J, true>();
+		distance_kernel = &Mandelbrot::calculate_kernel<
+			N, J, true, SmoothingMode::NONE, true>;
+		feature_kernel = &Mandelbrot::calculate_features_kernel<N, J, true>;
+		resume_kernel = &Mandelbrot::calculate_resume_kernel<N, J, true>;
+	}
+	else
+	{
+		select_point_kernels<N, J, false>();
+		distance_kernel = &Mandelbrot::calculate_kernel<
+			N, J, false, SmoothingMode::NONE, true>;
+		feature_kernel = &Mandelbrot::calculate_features_kernel<N, J, false>;
+		resume_kernel = &Mandelbrot::calculate_resume_kernel<N, J, false>;
+	}
+}
+
+template <int N, int J, bool Blackhole>
+void
+CC::Mandelbrot::select_point_kernels()
+{
+	switch (data.smoothing)
+	{
+	case SmoothingMode::NORMALIZED:
+		set_point_kernels<N, J, Blackhole, SmoothingMode::NORMALIZED>();
+		break;
+	case SmoothingMode::NONE:
+		set_point_kernels<N, J, Blackhole, SmoothingMode::NONE>();
+		break;
+	default:
+		set_point_kernels<N, J, Blackhole, SmoothingMode::EXPONENTIAL>();
+		break;
+	}
+}
+
+template <int N, int J, bool Blackhole, CC::SmoothingMode Smoothing>
+void
+CC::Mandelbrot::set_point_kernels()
+{
+	point_kernel = &Mandelbrot::calculate_kernel<
+		N, J, Blackhole, Smoothing, false>;
+	batch_kernel = &Mandelbrot::calculate_batch_kernel<
+		N, J, Blackhole, Smoothing>;
+}
+
 CC::FractalCoordsInfo
 CC::Mandelbrot::calculate(COMPLEX coords)
+{
+	return (this->*point_kernel)(coords);
+}
+
+void
+CC::Mandelbrot::calculate_batch(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	const FractalBatchInfo& results)
+{
+	calculate_batch(real, imag, size, results, Precision::DOUBLE);
+}
+
+void
+CC::Mandelbrot::calculate_batch(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	const FractalBatchInfo& results, Precision precision)
+{
+	// The vectorized engine always writes iteration counts.
+	if (results.num_iter && calculate_simd(
+		real, imag, size, results.num_iter, results.smooth,
+		results.z_real, results.z_imag, precision))
+		return;
+
+	(this->*batch_kernel)(real, imag, size, results);
+}
+
+template <int N, int J, bool Blackhole, CC::SmoothingMode Smoothing>
+void
+CC::Mandelbrot::calculate_batch_kernel(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	const FractalBatchInfo& results)
+{
+	for (exint i = 0; i < size; i++)
+		results.write(i, calculate_kernel<N, J, Blackhole, Smoothing, false>(
+			COMPLEX(real[i], imag[i])));
+}
+
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_distance(COMPLEX coords)
+{
+	return (this->*distance_kernel)(coords);
+}
+
+template <int N, int J, bool Blackhole, CC::SmoothingMode Smoothing,
+	bool Distance>
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_kernel(COMPLEX coords)
 {
 	// Declares z and c where:Calculates the basic mandelbrot formula
 	// z = z^pow + c;
 	COMPLEX z{ 0 };
 	COMPLEX c{ coords.real(), coords.imag() };
 
+	// Derivative of z with respect to c, and the distance estimate.
+	COMPLEX dz{ 0 };
+	fpreal distance{ 0.0 };
+
+	// Points in the main cardioid or period-2 bulb would run every iteration
+	// only to be blackholed. z is left uniterated for them.
+	if (N == 2 && J == 0 && Blackhole && interior_test &&
+		in_cardioid_or_bulb(c.real(), c.imag()))
+		return FractalCoordsInfo(-1, z, -1.0);
+
+	// Escape is tested against the squared norm to avoid a sqrt per iteration.
+	fpreal bailout_sq = data.bailout * data.bailout;
+
+	// Bounded orbits settle into cycles. When blackholed, an orbit that
+	// returns to its checkpoint (Brent's method, refreshed at powers of two)
+	// is classified as interior without running out its iterations.
+	bool check_period = Blackhole && data.periodicity;
+	fpreal period_tol_sq = data.periodtol * data.periodtol;
+	COMPLEX checkpoint{ 0 };
+	exint refresh{ 1 };
+
+	// Normalized smoothing is calculated once, after the loop.
 	int iterations{ 0 };
-	fpreal smoothcolor = exp(-abs(-z));
+	fpreal smoothcolor = Smoothing == SmoothingMode::EXPONENTIAL ?
+		exp(-abs(-z)) : 0.0;
 
 	while (iterations < data.iters)
 	{
-		z = calculate_z(z, c);
-		smoothcolor += exp(-abs(-z));
+		if (Distance)
+			z = calculate_z_kernel<N, J>(z, c, dz);
+		else
+			z = calculate_z_kernel<N, J>(z, c);
 
-		if (abs(z) > data.bailout)
+		if (Smoothing == SmoothingMode::EXPONENTIAL)
+			smoothcolor += exp(-abs(-z));
+
+		if (std::norm(z) > bailout_sq)
+		{
+			if (Distance)
+				distance = settle_distance<N, J>(z, c, dz);
 			break;
+		}
 
 		++iterations;
+
+		if (check_period)
+		{
+			if (std::norm(z - checkpoint) < period_tol_sq)
+			{
+				iterations = data.iters;
+				break;
+			}
+
+			if (iterations == refresh)
+			{
+				checkpoint = z;
+				refresh *= 2;
+			}
+		}
 	}
 
+	if (Smoothing == SmoothingMode::NORMALIZED)
+		smoothcolor = normalized_iterations(
+			iterations, data.iters, z, log_bailout, log_degree);
+
 	// Blackhole if maximum iterations reached
 	// Itersations set to -1 for bailed out values,
 	// making it a unique value for mattes.
+	if (Blackhole && iterations == data.iters)
+	{
+		iterations = -1;
+		smoothcolor = -1.0;
+	}
+	return FractalCoordsInfo(iterations, z, smoothcolor, distance);
+}
+
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_features(
+	COMPLEX coords,
+	const OrbitFeatureSettings& settings,
+	OrbitFeatures& features)
+{
+	return (this->*feature_kernel)(coords, settings, features);
+}
+
+template <int N, int J, bool Blackhole>
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_features_kernel(
+	COMPLEX coords,
+	const OrbitFeatureSettings& settings,
+	OrbitFeatures& features)
+{
+	COMPLEX z{ 0 };
+	COMPLEX c{ coords.real(), coords.imag() };
+	COMPLEX dz{ 0 };
+	fpreal distance{ 0.0 };
+
+	// See calculate_kernel.
+	fpreal bailout_sq = data.bailout * data.bailout;
+	bool check_period = Blackhole && data.periodicity;
+	fpreal period_tol_sq = data.periodtol * data.periodtol;
+	COMPLEX checkpoint{ 0 };
+	exint refresh{ 1 };
+
+	bool exponential = data.smoothing == SmoothingMode::EXPONENTIAL;
+	int iterations{ 0 };
+	fpreal smoothcolor = exponential ? exp(-abs(-z)) : 0.0;
+	bool escaped{ false };
+
+	// Stripe average terms of the bounded iterations. The last term is kept
+	// so the average can be blended with the one before it.
+	fpreal stripe_sum{ 0.0 };
+	fpreal stripe_last{ 0.0 };
+	int stripe_count{ 0 };
+
+	// Arbitrary far distance, as in Pickover::calculate.
+	fpreal trap{ 1e10 };
+
+	while (iterations < data.iters)
+	{
+		z = calculate_z_kernel<N, J>(z, c, dz);
+
+		if (exponential)
+			smoothcolor += exp(-abs(-z));
+
+		trap = SYSmin(trap, std::abs(z - settings.trap_point));
+
+		if (std::norm(z) > bailout_sq)
+		{
+			escaped = true;
+			if (settings.distance)
+				distance = settle_distance<N, J>(z, c, dz);
+			break;
+		}
+
+		++iterations;
+
+		stripe_last = 0.5 * std::sin(
+			settings.stripe_density * std::arg(z)) + 0.5;
+		stripe_sum += stripe_last;
+		++stripe_count;
+
+		// An orbit back at its checkpoint only repeats its stripe terms and
+		// trap distances, so stopping leaves both as they would end.
+		if (check_period)
+		{
+			if (std::norm(z - checkpoint) < period_tol_sq)
+			{
+				iterations = data.iters;
+				break;
+			}
+
+			if (iterations == refresh)
+			{
+				checkpoint = z;
+				refresh *= 2;
+			}
+		}
+	}
+
+	fpreal normalized = normalized_iterations(
+		iterations, data.iters, z, log_bailout, log_degree);
+	if (data.smoothing == SmoothingMode::NORMALIZED)
+		smoothcolor = normalized;
+
+	features.dz = dz;
+	features.trap = trap;
+	features.stripe = 0.0;
+
+	// Escaped orbits blend the averages with and without the last term by
+	// the fractional iteration, so the stripes don't band at each iteration.
+	if (stripe_count > 0)
+	{
+		fpreal average = stripe_sum / stripe_count;
+		features.stripe = average;
+
+		if (escaped && stripe_count > 1)
+		{
+			fpreal previous = (stripe_sum - stripe_last) / (stripe_count - 1);
+			fpreal blend = SYSclamp(normalized - iterations, 0.0, 1.0);
+			features.stripe = SYSlerp(previous, average, blend);
+		}
+	}
+
+	// See calculate_kernel.
+	if (Blackhole && iterations == data.iters)
+	{
+		iterations = -1;
+		smoothcolor = -1.0;
+	}
+	return FractalCoordsInfo(iterations, z, smoothcolor, distance);
+}
+
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_resume(COMPLEX coords, OrbitState& state)
+{
+	return (this->*resume_kernel)(coords, state);
+}
+
+void
+CC::Mandelbrot::start_resume(COMPLEX c, OrbitState& state) const
+{
+	// Iterations can't be rolled back, so orbits that ended past the current
+	// limit start over.
+	if ((state.status == OrbitState::ESCAPED &&
+		state.iterations >= data.iters) ||
+		(state.status == OrbitState::BOUNDED &&
+		state.iterations > data.iters))
+		state = OrbitState();
+
+	if (state.status == OrbitState::UNSTARTED)
+	{
+		state.z = 0.0;
+		state.smooth = exp(-abs(-state.z));
+		state.iterations = 0;
+		state.status = OrbitState::BOUNDED;
+
+		// See calculate_kernel. interior_test is only set for the canonical
+		// set, with blackhole enabled.
+		if (interior_test && in_cardioid_or_bulb(c.real(), c.imag()))
+			state.status = OrbitState::INTERIOR;
+	}
+}
+
+CC::FractalCoordsInfo
+CC::Mandelbrot::finish_resume(const OrbitState& state) const
+{
+	// Blackhole if maximum iterations reached, see calculate_kernel. Interior
+	// orbits are only found when blackholed.
+	if (state.status == OrbitState::INTERIOR ||
+		(data.blackhole && state.status == OrbitState::BOUNDED))
+		return FractalCoordsInfo(-1, state.z, -1.0);
+
+	int iterations = state.iterations;
+	fpreal smoothcolor{ 0.0 };
+
+	switch (data.smoothing)
+	{
+	case SmoothingMode::EXPONENTIAL:
+		smoothcolor = state.smooth;
+		break;
+	case SmoothingMode::NORMALIZED:
+		smoothcolor = normalized_iterations(
+			iterations, data.iters, state.z, log_bailout, log_degree);
+		break;
+	default:
+		break;
+	}
+
+	return FractalCoordsInfo(iterations, state.z, smoothcolor);
+}
+
+void
+CC::Mandelbrot::calculate_resume_batch(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	OrbitState* states, const FractalBatchInfo& results)
+{
+	// The engine only has kernels for whole exponents, see calculate_simd.
+	SIMDInstructionSet isa = get_simd_instruction_set();
+	if (isa == SIMDInstructionSet::SCALAR || kernel_power == 0)
+	{
+		for (exint i = 0; i < size; i++)
+			results.write(i, (this->*resume_kernel)(
+				COMPLEX(real[i], imag[i]), states[i]));
+		return;
+	}
+
+	// The engine always runs at least one iteration, so only orbits with
+	// iterations left are continued.
+	std::vector<exint> pending;
+	for (exint i = 0; i < size; i++)
+	{
+		start_resume(COMPLEX(real[i], imag[i]), states[i]);
+		if (states[i].status == OrbitState::BOUNDED &&
+			states[i].iterations < data.iters)
+			pending.push_back(i);
+	}
+
+	exint count = pending.size();
+	if (count)
+	{
+		std::vector<fpreal64> c_real(count), c_imag(count);
+		std::vector<fpreal64> z_real(count), z_imag(count), smooth(count);
+		std::vector<int> iters(count), num_iter(count);
+		std::unique_ptr<bool[]> periodic(new bool[count]);
+
+		for (exint p = 0; p < count; p++)
+		{
+			const OrbitState& state = states[pending[p]];
+			c_real[p] = real[pending[p]];
+			c_imag[p] = imag[pending[p]];
+			z_real[p] = state.z.real();
+			z_imag[p] = state.z.imag();
+			smooth[p] = state.smooth;
+			iters[p] = state.iterations;
+		}
+
+		// Counts are written unblackholed, so bounded orbits can be told
+		// apart from interior ones. The outputs overwrite the start arrays
+		// only as each lane finishes, after its start was read.
+		MandelbrotBatch batch;
+		batch.real = c_real.data();
+		batch.imag = c_imag.data();
+		batch.size = count;
+		batch.power = kernel_power;
+		batch.iters = data.iters;
+		batch.bailout = data.bailout;
+		batch.jdepth = data.jdepth;
+		batch.joffset_real = data.joffset.real();
+		batch.joffset_imag = data.joffset.imag();
+		batch.periodicity = data.periodicity && data.blackhole;
+		batch.periodtol = data.periodtol;
+		batch.num_iter = num_iter.data();
+		batch.smooth_values = smooth.data();
+		batch.z_real = z_real.data();
+		batch.z_imag = z_imag.data();
+		batch.start_real = z_real.data();
+		batch.start_imag = z_imag.data();
+		batch.start_smooth = smooth.data();
+		batch.start_iters = iters.data();
+		batch.periodic = periodic.get();
+
+		if (isa == SIMDInstructionSet::AVX512)
+			calculate_mandelbrot_avx512(batch);
+		else
+			calculate_mandelbrot_avx2(batch);
+
+		for (exint p = 0; p < count; p++)
+		{
+			OrbitState& state = states[pending[p]];
+			state.z = COMPLEX(z_real[p], z_imag[p]);
+			state.smooth = smooth[p];
+			state.iterations = num_iter[p];
+
+			if (periodic[p])
+				state.status = OrbitState::INTERIOR;
+			else if (num_iter[p] < data.iters)
+				state.status = OrbitState::ESCAPED;
+		}
+	}
+
+	for (exint i = 0; i < size; i++)
+		results.write(i, finish_resume(states[i]));
+}
+
+template <int N, int J, bool Blackhole>
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_resume_kernel(COMPLEX coords, OrbitState& state)
+{
+	COMPLEX c{ coords.real(), coords.imag() };
+	start_resume(c, state);
+
+	if (state.status == OrbitState::BOUNDED)
+	{
+		COMPLEX z = state.z;
+		int iterations = state.iterations;
+		fpreal smoothcolor = state.smooth;
+
+		// See calculate_kernel. A resumed orbit takes its checkpoint where
+		// it stopped, and refreshes it at the following powers of two.
+		fpreal bailout_sq = data.bailout * data.bailout;
+		bool check_period = Blackhole && data.periodicity;
+		fpreal period_tol_sq = data.periodtol * data.periodtol;
+		COMPLEX checkpoint = z;
+		exint refresh{ 1 };
+		while (refresh <= iterations)
+			refresh *= 2;
+
+		while (iterations < data.iters)
+		{
+			z = calculate_z_kernel<N, J>(z, c);
+			smoothcolor += exp(-abs(-z));
+
+			if (std::norm(z) > bailout_sq)
+			{
+				state.status = OrbitState::ESCAPED;
+				break;
+			}
+
+			++iterations;
+
+			if (check_period)
+			{
+				if (std::norm(z - checkpoint) < period_tol_sq)
+				{
+					state.status = OrbitState::INTERIOR;
+					break;
+				}
+
+				if (iterations == refresh)
+				{
+					checkpoint = z;
+					refresh *= 2;
+				}
+			}
+		}
+
+		state.z = z;
+		state.iterations = iterations;
+		state.smooth = smoothcolor;
+	}
+
+	return finish_resume(state);
+}
+
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_dd(const ComplexDD& coords)
+{
+	// Fractional exponents have no double-double kernel.
+	if (kernel_power == 0)
+		return calculate(coords.to_complex());
+
+	return (this->*dd_kernel)(coords);
+}
+
+template <int N>
+CC::FractalCoordsInfo
+CC::Mandelbrot::calculate_kernel_dd(const ComplexDD& c)
+{
+	// Same iteration as calculate_kernel. Only z and c need the extra
+	// precision, the escape, cycle and smoothing tests are all relative to
+	// values far larger than a pixel, and are made in fpreal64.
+	ComplexDD z;
+	COMPLEX z_double{ 0 };
+	COMPLEX c_double = c.to_complex();
+	ComplexDD joffset(data.joffset);
+
+	if (N == 2 && interior_test &&
+		in_cardioid_or_bulb(c_double.real(), c_double.imag()))
+		return FractalCoordsInfo(-1, z_double, -1.0);
+
+	fpreal bailout_sq = data.bailout * data.bailout;
+
+	bool check_period = data.periodicity && data.blackhole;
+	fpreal period_tol_sq = data.periodtol * data.periodtol;
+	ComplexDD checkpoint;
+	exint refresh{ 1 };
+
+	bool exponential = data.smoothing == SmoothingMode::EXPONENTIAL;
+
+	int iterations{ 0 };
+	fpreal smoothcolor = exponential ? exp(-abs(-z_double)) : 0.0;
+
+	while (iterations < data.iters)
+	{
+		z = ipow_dd<N>(z) + c;
+		for (int julia = 0; julia < data.jdepth; julia++)
+			z = ipow_dd<N>(z) + joffset;
+
+		z_double = z.to_complex();
+
+		if (exponential)
+			smoothcolor += exp(-abs(-z_double));
+
+		if (std::norm(z_double) > bailout_sq)
+			break;
+
+		++iterations;
+
+		if (check_period)
+		{
+			if (std::norm((z - checkpoint).to_complex()) < period_tol_sq)
+			{
+				iterations = data.iters;
+				break;
+			}
+
+			if (iterations == refresh)
+			{
+				checkpoint = z;
+				refresh *= 2;
+			}
+		}
+	}
+
+	if (data.smoothing == SmoothingMode::NORMALIZED)
+		smoothcolor = normalized_iterations(
+			iterations, data.iters, z_double, log_bailout, log_degree);
+
 	if (data.blackhole && iterations == data.iters)
 	{
 		iterations = -1;
 		smoothcolor = -1.0;
 	}
-	return FractalCoordsInfo(iterations, z, smoothcolor);
+	return FractalCoordsInfo(iterations, z_double, smoothcolor);
+}
+
+template <int N, int J>
+fpreal
+CC::Mandelbrot::settle_distance(COMPLEX z, COMPLEX c, COMPLEX dz)
+{
+	// The estimate is only exact as |z| grows without bound. Rather than
+	// a huge bailout for every pixel, escaped orbits iterate just until
+	// successive estimates agree.
+	fpreal estimate = distance_estimate(z, dz);
+
+	// Far from the set, the first estimate is close enough.
+	if (distance_cutoff > 0.0 && estimate > distance_cutoff)
+		return estimate;
+
+	for (int i = 0; i < DISTANCE_MAX_ITERS; i++)
+	{
+		if (std::norm(z) > DISTANCE_ESCAPE_SQ)
+			break;
+
+		z = calculate_z_kernel<N, J>(z, c, dz);
+		fpreal next = distance_estimate(z, dz);
+		bool settled = std::abs(next - estimate) <= DISTANCE_TOLERANCE * next;
+		estimate = next;
+
+		if (settled)
+			break;
+	}
+
+	return estimate;
 }
 
 COMPLEX
 CC::Mandelbrot::calculate_z(COMPLEX z, COMPLEX c)
+{
+	return (this->*z_kernel)(z, c);
+}
+
+template <int N, int J>
+COMPLEX
+CC::Mandelbrot::calculate_z_kernel(COMPLEX z, COMPLEX c)
 {
 	// Calculate Mandelbrot
-	z = pow(z, data.power) + c;
+	z = kernel_pow<N>(z, data.power) + c;
 
 	// Calculate Julias, if present. A jdepth of 1 is the canonical Julia Set.
-	for (int julia = 0; julia < data.jdepth; julia++)
-		z = pow(z, data.power) + data.joffset;
+	// Known depths are unrolled by the compiler.
+	const int depth = J == KERNEL_JULIA_ANY ? data.jdepth : J;
+	for (int julia = 0; julia < depth; julia++)
+		z = kernel_pow<N>(z, data.power) + data.joffset;
 
 	return z;
 }
 
-CC::Pickover::Pickover(PickoverStashData & pickoverData)
+COMPLEX
+CC::Mandelbrot::calculate_z(COMPLEX z, COMPLEX c, COMPLEX& dz)
+{
+	return (this->*dz_kernel)(z, c, dz);
+}
+
+template <int N, int J>
+COMPLEX
+CC::Mandelbrot::calculate_z_kernel(COMPLEX z, COMPLEX c, COMPLEX& dz)
+{
+	// dz' = pow * z^(pow-1) * dz + 1, as c only enters the Mandelbrot step.
+	dz = complex_mult(kernel_dpow<N>(z, data.power), dz) + 1.0;
+	z = kernel_pow<N>(z, data.power) + c;
+
+	const int depth = J == KERNEL_JULIA_ANY ? data.jdepth : J;
+	for (int julia = 0; julia < depth; julia++)
+	{
+		dz = complex_mult(kernel_dpow<N>(z, data.power), dz);
+		z = kernel_pow<N>(z, data.power) + data.joffset;
+	}
+
+	return z;
+}
+
+bool
+CC::Mandelbrot::calculate_simd(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	int* num_iter, fpreal64* smooth, fpreal64* z_real, fpreal64* z_imag,
+	Precision precision)
+{
+	// The engine only has kernels for whole exponents, and always runs at
+	// least one iteration.
+	SIMDInstructionSet isa = get_simd_instruction_set();
+	if (isa == SIMDInstructionSet::SCALAR || kernel_power == 0 ||
+		data.iters < 1 || precision == Precision::DOUBLE_DOUBLE)
+		return false;
+
+	MandelbrotBatch batch;
+	batch.real = real;
+	batch.imag = imag;
+	batch.size = size;
+	batch.power = kernel_power;
+	batch.iters = data.iters;
+	batch.bailout = data.bailout;
+	batch.jdepth = data.jdepth;
+	batch.joffset_real = data.joffset.real();
+	batch.joffset_imag = data.joffset.imag();
+	batch.blackhole = data.blackhole;
+	batch.interior_test = interior_test;
+	batch.periodicity = data.periodicity && data.blackhole;
+	batch.periodtol = data.periodtol;
+	batch.smooth = smooth != nullptr;
+	batch.single = precision == Precision::SINGLE;
+	batch.num_iter = num_iter;
+	batch.smooth_values = smooth;
+	batch.z_real = z_real;
+	batch.z_imag = z_imag;
+
+	// Normalized smoothing only needs the final z values, so the engine
+	// skips the exponential sum and the values are filled in afterwards.
+	bool normalized = smooth && data.smoothing == SmoothingMode::NORMALIZED;
+	bool unsmoothed = smooth && data.smoothing == SmoothingMode::NONE;
+	if (unsmoothed)
+	{
+		batch.smooth = false;
+		batch.smooth_values = nullptr;
+	}
+
+	std::vector<fpreal64> final_real, final_imag;
+	if (normalized)
+	{
+		batch.smooth = false;
+		batch.smooth_values = nullptr;
+
+		if (!z_real)
+		{
+			final_real.resize(size);
+			batch.z_real = final_real.data();
+		}
+		if (!z_imag)
+		{
+			final_imag.resize(size);
+			batch.z_imag = final_imag.data();
+		}
+	}
+
+	if (isa == SIMDInstructionSet::AVX512)
+		calculate_mandelbrot_avx512(batch);
+	else
+		calculate_mandelbrot_avx2(batch);
+
+	if (normalized)
+	{
+		for (exint i = 0; i < size; i++)
+			smooth[i] = normalized_iterations(num_iter[i], data.iters,
+				COMPLEX(batch.z_real[i], batch.z_imag[i]),
+				log_bailout, log_degree);
+	}
+	else if (unsmoothed)
+	{
+		for (exint i = 0; i < size; i++)
+			smooth[i] = num_iter[i] < 0 ? -1.0 : 0.0;
+	}
+
+	return true;
+}
+
+CC::Pickover::Pickover()
+{
+	select_pickover_kernel();
+}
+
+/** The Mandelbrot base is given a copy of the Pickover's data so that the
+ * shared calculate_z kernels see the same exponent and Julia parameters. */
+CC::Pickover::Pickover(PickoverStashData & pickoverData) :
+	Mandelbrot(pickoverData)
 {
 	data = pickoverData;
+	select_pickover_kernel();
+}
+
+void
+CC::Pickover::select_pickover_kernel()
+{
+	switch (kernel_power)
+	{
+	case 2: select_pickover_kernel_for_power<2>(); break;
+	case 3: select_pickover_kernel_for_power<3>(); break;
+	case 4: select_pickover_kernel_for_power<4>(); break;
+	case 5: select_pickover_kernel_for_power<5>(); break;
+	case 6: select_pickover_kernel_for_power<6>(); break;
+	case 7: select_pickover_kernel_for_power<7>(); break;
+	case 8: select_pickover_kernel_for_power<8>(); break;
+	default: select_pickover_kernel_for_power<0>(); break;
+	}
+}
+
+template <int N>
+void
+CC::Pickover::select_pickover_kernel_for_power()
+{
+	switch (data.jdepth)
+	{
+	case 0: select_pickover_kernel_for_julia<N, 0>(); break;
+	case 1: select_pickover_kernel_for_julia<N, 1>(); break;
+	case 2: select_pickover_kernel_for_julia<N, 2>(); break;
+	default: select_pickover_kernel_for_julia<N, KERNEL_JULIA_ANY>(); break;
+	}
+}
+
+template <int N, int J>
+void
+CC::Pickover::select_pickover_kernel_for_julia()
+{
+	if (data.pomode)
+	{
+		if (data.blackhole)
+			set_pickover_kernels<N, J, true, true>();
+		else
+			set_pickover_kernels<N, J, true, false>();
+	}
+	else
+	{
+		if (data.blackhole)
+			set_pickover_kernels<N, J, false, true>();
+		else
+			set_pickover_kernels<N, J, false, false>();
+	}
+}
+
+template <int N, int J, bool Line, bool Blackhole>
+void
+CC::Pickover::set_pickover_kernels()
+{
+	pickover_kernel = &Pickover::calculate_kernel<N, J, Line, Blackhole>;
+	pickover_batch_kernel =
+		&Pickover::calculate_batch_kernel<N, J, Line, Blackhole>;
 }
 
 CC::FractalCoordsInfo
 CC::Pickover::calculate(COMPLEX coords)
+{
+	return (this->*pickover_kernel)(coords);
+}
+
+void
+CC::Pickover::calculate_batch(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	const FractalBatchInfo& results)
+{
+	(this->*pickover_batch_kernel)(real, imag, size, results);
+}
+
+template <int N, int J, bool Line, bool Blackhole>
+void
+CC::Pickover::calculate_batch_kernel(
+	const fpreal64* real, const fpreal64* imag, exint size,
+	const FractalBatchInfo& results)
+{
+	for (exint i = 0; i < size; i++)
+		results.write(i, calculate_kernel<N, J, Line, Blackhole>(
+			COMPLEX(real[i], imag[i])));
+}
+
+template <int N, int J, bool Line, bool Blackhole>
+CC::FractalCoordsInfo
+CC::Pickover::calculate_kernel(COMPLEX coords)
 {
 	COMPLEX z{ 0 };
 	COMPLEX c{ coords.real(), coords.imag() };
@@ -80,22 +952,26 @@ CC::Pickover::calculate(COMPLEX coords)
 	// In which case they would mostly be seeing flat values anyways.
 	fpreal distance{ 1e10 };
 
+	fpreal bailout_sq = data.bailout * data.bailout;
+
+	// Once an orbit returns to its checkpoint it only revisits points
+	// whose distances were already measured, so it can stop early.
+	// See Mandelbrot::calculate_kernel.
+	fpreal period_tol_sq = data.periodtol * data.periodtol;
+	COMPLEX checkpoint{ 0 };
+	exint refresh{ 1 };
+
 	for (int i = 0; i < data.iters; i++)
 	{
-		// Calculate Mandelbrot
-		z = pow(z, data.power) + c;
-
-		// Calculate Julias, if present.
-		// A jdepth of 1 is the canonical Julia Set.
-		for (int julia = 0; julia < data.jdepth; julia++)
-			z = pow(z, data.power) + data.joffset;
+		// Calculate Mandelbrot and Julias, if present.
+		z = calculate_z_kernel<N, J>(z, c);
 
 		// Calculate the distance
 		fpreal zLength{ 0 };
-		if (data.pomode == 0) // Calculate Point
-			zLength = distance_to_point(z, data.popoint);
-		else  // Calculate Line
+		if (Line)
 			zLength = distance_to_line(z, data.popoint, data.porotate);
+		else
+			zLength = distance_to_point(z, data.popoint);
 
 		// Assign distance if a smaller length than current distance.
 		if (zLength < distance)
@@ -105,8 +981,20 @@ CC::Pickover::calculate(COMPLEX coords)
 		// Based on the bailout value calculated on the pixel. This
 		// isn't in the canonical Pickover stalk, but it plays nicely and
 		// is consistent with the spirit of the CCFS.
-		if (data.blackhole && abs(z) > data.bailout)
+		if (Blackhole && std::norm(z) > bailout_sq)
 			break;
+
+		if (data.periodicity)
+		{
+			if (std::norm(z - checkpoint) < period_tol_sq)
+				break;
+
+			if (i + 1 == refresh)
+			{
+				checkpoint = z;
+				refresh *= 2;
+			}
+		}
 	}
 
 	return FractalCoordsInfo(0, 0, distance);
@@ -0,0 +1,136 @@
+/** \file MandelbrotAVX2.cpp
+	Source implementing the batch Mandelbrot engine with AVX2 vectors.
+
+ * This file is compiled with AVX2 enabled (see CMakeLists.txt), and must only
+ * be called after get_simd_instruction_set has confirmed CPU support.
+ */
+
+ // Local
+#include "MandelbrotSIMDKernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+// STL
+#include <immintrin.h>
+
+namespace
+{
+/**Vector traits wrapping the 4-wide AVX2 double precision intrinsics.*/
+struct AVX2Traits
+{
+	typedef fpreal64 S;
+	typedef __m256d V;
+	typedef __m256d M;
+	static const int WIDTH = 4;
+
+	/**Smallest argument whose exp doesn't underflow.*/
+	static inline fpreal64 exp_min() { return -708.0; }
+
+	static inline V set1(fpreal64 v) { return _mm256_set1_pd(v); }
+	static inline V load(const fpreal64* p) { return _mm256_load_pd(p); }
+	static inline void store(fpreal64* p, V v) { _mm256_store_pd(p, v); }
+
+	static inline V add(V a, V b) { return _mm256_add_pd(a, b); }
+	static inline V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+	static inline V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+	static inline V div(V a, V b) { return _mm256_div_pd(a, b); }
+	static inline V sqrt(V a) { return _mm256_sqrt_pd(a); }
+	static inline V max(V a, V b) { return _mm256_max_pd(a, b); }
+
+	static inline V
+	round(V a)
+	{
+		return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	}
+
+	/**Returns 2^n for integer valued lanes, built from the exponent bits.*/
+	static inline V
+	pow2n(V n)
+	{
+		__m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+		exponent = _mm256_add_epi64(exponent, _mm256_set1_epi64x(1023));
+		return _mm256_castsi256_pd(_mm256_slli_epi64(exponent, 52));
+	}
+
+	static inline M cmpgt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static inline M cmpeq(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+	static inline int bits(M m) { return _mm256_movemask_pd(m); }
+
+	/**Returns b in the lanes where m is set, and a elsewhere.*/
+	static inline V blend(V a, V b, M m) { return _mm256_blendv_pd(a, b, m); }
+
+	/**Returns a + b in the lanes where m is not set.*/
+	static inline V
+	add_unless(V a, V b, M m)
+	{
+		return _mm256_add_pd(a, _mm256_andnot_pd(m, b));
+	}
+};
+
+/**Vector traits wrapping the 8-wide AVX2 single precision intrinsics.*/
+struct AVX2FloatTraits
+{
+	typedef fpreal32 S;
+	typedef __m256 V;
+	typedef __m256 M;
+	static const int WIDTH = 8;
+
+	static inline fpreal64 exp_min() { return -87.0; }
+
+	static inline V set1(fpreal64 v) { return _mm256_set1_ps((fpreal32)v); }
+	static inline V load(const fpreal32* p) { return _mm256_load_ps(p); }
+	static inline void store(fpreal32* p, V v) { _mm256_store_ps(p, v); }
+
+	static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+	static inline V sqrt(V a) { return _mm256_sqrt_ps(a); }
+	static inline V max(V a, V b) { return _mm256_max_ps(a, b); }
+
+	static inline V
+	round(V a)
+	{
+		return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	}
+
+	/**Returns 2^n for integer valued lanes, built from the exponent bits.*/
+	static inline V
+	pow2n(V n)
+	{
+		__m256i exponent = _mm256_cvtps_epi32(n);
+		exponent = _mm256_add_epi32(exponent, _mm256_set1_epi32(127));
+		return _mm256_castsi256_ps(_mm256_slli_epi32(exponent, 23));
+	}
+
+	static inline M cmpgt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static inline M cmpeq(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	static inline int bits(M m) { return _mm256_movemask_ps(m); }
+
+	/**Returns b in the lanes where m is set, and a elsewhere.*/
+	static inline V blend(V a, V b, M m) { return _mm256_blendv_ps(a, b, m); }
+
+	/**Returns a + b in the lanes where m is not set.*/
+	static inline V
+	add_unless(V a, V b, M m)
+	{
+		return _mm256_add_ps(a, _mm256_andnot_ps(m, b));
+	}
+};
+}
+
+void
+CC::calculate_mandelbrot_avx2(const MandelbrotBatch& batch)
+{
+	if (batch.single)
+		simd::calculate_batch<AVX2FloatTraits>(batch);
+	else
+		simd::calculate_batch<AVX2Traits>(batch);
+}
+
+#else
+
+void
+CC::calculate_mandelbrot_avx2(const MandelbrotBatch& batch) {}
+
+#endif
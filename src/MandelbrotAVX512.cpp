@@ -0,0 +1,162 @@
+/** \file MandelbrotAVX512.cpp
+	Source implementing the batch Mandelbrot engine with AVX-512 vectors.
+
+ * This file is compiled with AVX-512 enabled (see CMakeLists.txt), and must
+ * only be called after get_simd_instruction_set has confirmed CPU support.
+ */
+
+ // Local
+#include "MandelbrotSIMDKernel.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+// STL
+#include <immintrin.h>
+
+namespace
+{
+/**Vector traits wrapping the 8-wide AVX-512 double precision intrinsics.*/
+struct AVX512Traits
+{
+	typedef fpreal64 S;
+	typedef __m512d V;
+	typedef __mmask8 M;
+	static const int WIDTH = 8;
+
+	/**Smallest argument whose exp doesn't underflow.*/
+	static inline fpreal64 exp_min() { return -708.0; }
+
+	static inline V set1(fpreal64 v) { return _mm512_set1_pd(v); }
+	static inline V load(const fpreal64* p) { return _mm512_load_pd(p); }
+	static inline void store(fpreal64* p, V v) { _mm512_store_pd(p, v); }
+
+	static inline V add(V a, V b) { return _mm512_add_pd(a, b); }
+	static inline V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+	static inline V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+	static inline V div(V a, V b) { return _mm512_div_pd(a, b); }
+	static inline V sqrt(V a) { return _mm512_sqrt_pd(a); }
+	static inline V max(V a, V b) { return _mm512_max_pd(a, b); }
+
+	static inline V
+	round(V a)
+	{
+		return _mm512_roundscale_pd(
+			a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	}
+
+	/**Returns 2^n for integer valued lanes.*/
+	static inline V
+	pow2n(V n)
+	{
+		return _mm512_scalef_pd(_mm512_set1_pd(1.0), n);
+	}
+
+	static inline M
+	cmpgt(V a, V b)
+	{
+		return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+	}
+
+	static inline M
+	cmpeq(V a, V b)
+	{
+		return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ);
+	}
+
+	static inline int bits(M m) { return static_cast<int>(m); }
+
+	/**Returns b in the lanes where m is set, and a elsewhere.*/
+	static inline V
+	blend(V a, V b, M m)
+	{
+		return _mm512_mask_blend_pd(m, a, b);
+	}
+
+	/**Returns a + b in the lanes where m is not set.*/
+	static inline V
+	add_unless(V a, V b, M m)
+	{
+		return _mm512_mask_add_pd(a, static_cast<M>(~m), a, b);
+	}
+};
+
+/**Vector traits wrapping the 16-wide AVX-512 single precision intrinsics.*/
+struct AVX512FloatTraits
+{
+	typedef fpreal32 S;
+	typedef __m512 V;
+	typedef __mmask16 M;
+	static const int WIDTH = 16;
+
+	static inline fpreal64 exp_min() { return -87.0; }
+
+	static inline V set1(fpreal64 v) { return _mm512_set1_ps((fpreal32)v); }
+	static inline V load(const fpreal32* p) { return _mm512_load_ps(p); }
+	static inline void store(fpreal32* p, V v) { _mm512_store_ps(p, v); }
+
+	static inline V add(V a, V b) { return _mm512_add_ps(a, b); }
+	static inline V sub(V a, V b) { return _mm512_sub_ps(a, b); }
+	static inline V mul(V a, V b) { return _mm512_mul_ps(a, b); }
+	static inline V div(V a, V b) { return _mm512_div_ps(a, b); }
+	static inline V sqrt(V a) { return _mm512_sqrt_ps(a); }
+	static inline V max(V a, V b) { return _mm512_max_ps(a, b); }
+
+	static inline V
+	round(V a)
+	{
+		return _mm512_roundscale_ps(
+			a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	}
+
+	/**Returns 2^n for integer valued lanes.*/
+	static inline V
+	pow2n(V n)
+	{
+		return _mm512_scalef_ps(_mm512_set1_ps(1.0f), n);
+	}
+
+	static inline M
+	cmpgt(V a, V b)
+	{
+		return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+	}
+
+	static inline M
+	cmpeq(V a, V b)
+	{
+		return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ);
+	}
+
+	static inline int bits(M m) { return static_cast<int>(m); }
+
+	/**Returns b in the lanes where m is set, and a elsewhere.*/
+	static inline V
+	blend(V a, V b, M m)
+	{
+		return _mm512_mask_blend_ps(m, a, b);
+	}
+
+	/**Returns a + b in the lanes where m is not set.*/
+	static inline V
+	add_unless(V a, V b, M m)
+	{
+		return _mm512_mask_add_ps(a, static_cast<M>(~m), a, b);
+	}
+};
+}
+
+void
+CC::calculate_mandelbrot_avx512(const MandelbrotBatch& batch)
+{
+	if (batch.single)
+		simd::calculate_batch<AVX512FloatTraits>(batch);
+	else
+		simd::calculate_batch<AVX512Traits>(batch);
+}
+
+#else
+
+void
+CC::calculate_mandelbrot_avx512(const MandelbrotBatch& batch) {}
+
+#endif
@@ -0,0 +1,59 @@
+/** \file MandelbrotSIMD.cpp
+	Source detecting the instruction sets used by the batch Mandelbrot engine.
+ */
+
+ // Local
+#include "MandelbrotSIMD.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace
+{
+/**Queries the CPU (and the OS's saved register state) for the widest
+ * instruction set the engine supports.*/
+CC::SIMDInstructionSet
+detect_simd_instruction_set()
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	int info[4];
+	__cpuid(info, 0);
+	int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (max_leaf < 7 || !osxsave)
+		return CC::SIMDInstructionSet::SCALAR;
+
+	// The OS must save the YMM (and for AVX-512, the ZMM and mask) registers.
+	unsigned long long xcr0 = _xgetbv(0);
+	bool ymm_enabled = (xcr0 & 0x6) == 0x6;
+	bool zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+
+	__cpuidex(info, 7, 0);
+	if (ymm_enabled && zmm_enabled && (info[1] & (1 << 16)))
+		return CC::SIMDInstructionSet::AVX512;
+	if (ymm_enabled && (info[1] & (1 << 5)))
+		return CC::SIMDInstructionSet::AVX2;
+
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+	// These also verify that the OS saves the wider registers.
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return CC::SIMDInstructionSet::AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return CC::SIMDInstructionSet::AVX2;
+#endif
+
+	return CC::SIMDInstructionSet::SCALAR;
+}
+}
+
+CC::SIMDInstructionSet
+CC::get_simd_instruction_set()
+{
+	// Static initialization is threadsafe, and only runs once per session.
+	static const SIMDInstructionSet isa = detect_simd_instruction_set();
+	return isa;
+}
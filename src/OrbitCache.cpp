@@ -0,0 +1,67 @@
+/** \file OrbitCache.cpp
+	Source defining the cache of per-pixel orbit state kept between cooks.
+ */
+
+ // Local
+#include "OrbitCache.h"
+
+CC::OrbitCacheKey::OrbitCacheKey(
+	const MandelbrotStashData& data,
+	const FractalSpace& space) :
+	power(data.power), bailout(data.bailout), jdepth(data.jdepth),
+	joffset(data.joffset), blackhole(data.blackhole),
+	periodicity(data.periodicity), periodtol(data.periodtol)
+{
+	// Pixel coordinates are affine, so these fix all of them.
+	origin = space.get_origin();
+	step_x = space.get_step_x();
+	step_y = space.get_step_y();
+}
+
+bool
+CC::OrbitCacheKey::operator==(const OrbitCacheKey& other) const
+{
+	return power == other.power &&
+		bailout == other.bailout &&
+		jdepth == other.jdepth &&
+		joffset == other.joffset &&
+		blackhole == other.blackhole &&
+		periodicity == other.periodicity &&
+		periodtol == other.periodtol &&
+		origin == other.origin &&
+		step_x == other.step_x &&
+		step_y == other.step_y;
+}
+
+void
+CC::OrbitCache::set_key(const OrbitCacheKey& new_key)
+{
+	UT_AutoLock lock_tiles(lock);
+	if (new_key == key)
+		return;
+
+	key = new_key;
+	tiles.clear();
+}
+
+std::shared_ptr<CC::OrbitCacheTile>
+CC::OrbitCache::get_tile(int x, int y, exint size)
+{
+	UT_AutoLock lock_tiles(lock);
+	std::shared_ptr<OrbitCacheTile>& tile = tiles[std::make_pair(x, y)];
+
+	if (!tile)
+		tile = std::make_shared<OrbitCacheTile>();
+
+	if (static_cast<exint>(tile->states.size()) != size)
+		tile->states.assign(size, OrbitState());
+
+	return tile;
+}
+
+void
+CC::OrbitCache::clear()
+{
+	UT_AutoLock lock_tiles(lock);
+	tiles.clear();
+}
@@ -0,0 +1,191 @@
+/** \file Progressive.cpp
+	Source defining the refinement of progressive tiles between cooks.
+ */
+
+ // Local
+#include "Progressive.h"
+#include "Antialias.h"
+#include "Fractal.h"
+#include "FractalSpace.h"
+
+// STL
+#include <algorithm>
+#include <vector>
+
+// HDK
+#include <OP/OP_Node.h>
+#include <UI/UI_Event.h>
+#include <UI/UI_Object.h>
+#include <UI/UI_Queue.h>
+#include <UT/UT_Lock.h>
+
+namespace
+{
+/**Recooks nodes from the UI event loop. Tile threads can't recook the node
+ * they are cooking, so they only queue its id and post an event, which the
+ * main thread handles once the cook has returned.*/
+class RefinementQueue : public UI_Object
+{
+public:
+	void schedule(int id)
+	{
+		UT_AutoLock lock_ids(lock);
+
+		// One event recooks every node queued before it is handled.
+		if (ids.empty())
+			UIgetQueue()->appendEvent(
+				UI_Event(UI_EVENT_VALUE_CHANGE, this, this));
+
+		ids.push_back(id);
+	}
+
+	void handleEvent(UI_Event* event) override
+	{
+		std::vector<int> pending;
+		{
+			UT_AutoLock lock_ids(lock);
+			pending.swap(ids);
+		}
+
+		// Nodes may have been deleted since they were queued.
+		for (int id : pending)
+		{
+			OP_Node* node = OP_Node::lookupNode(id);
+			if (node)
+				node->forceRecook();
+		}
+	}
+
+private:
+	std::vector<int> ids;
+	UT_Lock lock;
+};
+
+RefinementQueue&
+get_refinement_queue()
+{
+	static RefinementQueue queue;
+	return queue;
+}
+}  // End of anonymous Namespace
+
+CC::ProgressiveKey::ProgressiveKey(
+	OP_Node* node,
+	fpreal t,
+	int size_x,
+	int size_y) :
+	version(node->getVersionParms()), time(t), size_x(size_x), size_y(size_y)
+{}
+
+void
+CC::schedule_refinement(OP_Node* node, std::atomic<bool>& scheduled)
+{
+	if (scheduled.exchange(true))
+		return;
+
+	get_refinement_queue().schedule(node->getUniqueId());
+}
+
+void
+CC::calculate_smooth_tile(
+	OP_Node* node,
+	Fractal& fractal,
+	const FractalSpace& space,
+	const AntialiasStashData& antialias,
+	ProgressiveCache<std::vector<fpreal32>>* progressive,
+	const CookDeadline& deadline,
+	std::atomic<bool>& refining,
+	TIL_TileList* tileList,
+	TIL_Tile* tile,
+	fpreal32* dest)
+{
+	int size_x, size_y;
+	tile->getSize(size_x, size_y);
+
+	const TileCoords coords(space, tileList, tile);
+
+	// Coordinates and values of a batch of pixels, such as a tile row.
+	std::vector<fpreal64> real, imag, values;
+	std::vector<fpreal32> samples(static_cast<exint>(size_x) * size_y);
+
+	// Calculates the values of a batch of fractal coordinates.
+	auto calculate_coords = [&](exint count)
+	{
+		values.resize(count);
+
+		FractalBatchInfo results;
+		results.smooth = values.data();
+		fractal.calculate_batch(real.data(), imag.data(), count, results);
+	};
+
+	// Calculates a batch of the tile's pixels, given by index.
+	auto calculate_pixels = [&](const std::vector<exint>& pixels)
+	{
+		exint count = pixels.size();
+		real.resize(count);
+		imag.resize(count);
+
+		for (exint i = 0; i < count; i++)
+		{
+			COMPLEX fractalCoords = coords[pixels[i]];
+			real[i] = fractalCoords.real();
+			imag[i] = fractalCoords.imag();
+		}
+
+		calculate_coords(count);
+
+		for (exint i = 0; i < count; i++)
+			samples[pixels[i]] = values[i];
+	};
+
+	// Whether every pixel has its own sample.
+	bool complete{ true };
+
+	// Refine the tile coarse to fine, until the cook's deadline, continuing
+	// from the last cook's samples.
+	if (progressive)
+	{
+		complete = refine_progressive_tile(
+			node, refining, deadline, *progressive,
+			tileList->myX1, tileList->myY1, size_x, size_y,
+			samples, calculate_pixels);
+	}
+	else
+	{
+		std::vector<exint> batch(size_x);
+		for (int y = 0; y < size_y; y++)
+		{
+			for (int x = 0; x < size_x; x++)
+				batch[x] = static_cast<exint>(y) * size_x + x;
+
+			calculate_pixels(batch);
+		}
+	}
+
+	std::copy(samples.begin(), samples.end(), dest);
+
+	// Calculates samples at image pixel coordinates.
+	auto sample_pixels = [&](
+		const std::vector<COMPLEX>& pixel_coords,
+		std::vector<fpreal32>& pixel_samples)
+	{
+		exint count = pixel_coords.size();
+		real.resize(count);
+		imag.resize(count);
+
+		for (exint i = 0; i < count; i++)
+		{
+			COMPLEX fractalCoords = space.get_fractal_coords(pixel_coords[i]);
+			real[i] = fractalCoords.real();
+			imag[i] = fractalCoords.imag();
+		}
+
+		calculate_coords(count);
+
+		for (exint i = 0; i < count; i++)
+			pixel_samples[i] = values[i];
+	};
+
+	if (complete)
+		antialias_tile(tileList, tile, antialias, dest, sample_pixels);
+}
@@ -15,6 +15,11 @@
 #include "typedefs.h"
 #include "FractalSpace.h"
 
+// HDK
+#include <HOM/HOM_Module.h>
+#include <SYS/SYS_Math.h>
+#include <UT/UT_String.h>
+
 CC::XformStashData::XformStashData(
 	fpreal offset_x, fpreal offset_y,
 	fpreal rotate, fpreal scale, RSTORDER xord) :
@@ -37,14 +42,49 @@ CC::XformStashData::evalArgs(const OP_Node* node, fpreal t)
 		xord = RSTORDER::STR;
 }
 
+void
+CC::DeepZoomStashData::evalArgs(const OP_Node* node, fpreal t)
+{
+	enable = node->evalInt(DEEPZOOM_NAME.first, 0, t) > 0;
+	series = node->evalInt(DEEPSERIES_NAME.first, 0, t) > 0;
+
+	// Strings keep every digit the artist typed.
+	UT_String value;
+	node->evalString(value, DEEPCENTER_NAME.first, 0, t);
+	center_x = value.toStdString();
+	node->evalString(value, DEEPCENTER_NAME.first, 1, t);
+	center_y = value.toStdString();
+	node->evalString(value, DEEPSCALE_NAME.first, 0, t);
+	scale = value.toStdString();
+}
+
+void
+CC::ProgressiveStashData::evalArgs(const OP_Node* node, fpreal t)
+{
+	// Renders, ROPs and sessions without a viewer calculate every pixel.
+	enable = node->evalInt(PROGRESSIVE_NAME.first, 0, t) > 0 &&
+		!node->isCookingRender() && HOM().isUIAvailable();
+	budget = node->evalFloat(BUDGET_NAME.first, 0, t);
+}
+
+void
+CC::AntialiasStashData::evalArgs(const OP_Node* node, fpreal t)
+{
+	samples = SYSmax(1, static_cast<int>(
+		node->evalInt(AASAMPLES_NAME.first, 0, t)));
+	threshold = node->evalFloat(AATHRESHOLD_NAME.first, 0, t);
+}
+
 CC::MandelbrotStashData::MandelbrotStashData(
 	int iters, fpreal power, fpreal bailout,
 	int jdepth, COMPLEX joffset,
-	bool blackhole) :
+	bool blackhole, bool periodicity, fpreal periodtol) :
 	iters(iters), power(power), bailout(bailout),
 	jdepth(jdepth),
 	joffset(joffset),
-	blackhole(blackhole)
+	blackhole(blackhole),
+	periodicity(periodicity),
+	periodtol(periodtol)
 {}
 
 void
@@ -59,6 +99,31 @@ CC::MandelbrotStashData::evalArgs(const OP_Node * node, fpreal t)
 	joffset = COMPLEX(joffset_x, joffset_y);
 	int rawblackhole = node->evalInt(BLACKHOLE_NAME.first, 0, t);
 	blackhole = rawblackhole > 0; // Make boolean
+	periodicity = node->evalInt(PERIODICITY_NAME.first, 0, t) > 0;
+	periodtol = node->evalFloat(PERIODTOL_NAME.first, 0, t);
+}
+
+int
+CC::MandelbrotStashData::get_kernel_power() const
+{
+	// Only whole exponents have a repeated-squaring kernel.
+	if (power < 2 || power > MAX_KERNEL_POWER || power != SYSfloor(power))
+		return 0;
+
+	return static_cast<int>(power);
+}
+
+void
+CC::MandelbrotStashData::fit_period_tolerance(fpreal pixel_size)
+{
+	periodtol = SYSmin(periodtol, PERIOD_TOL_PIXELS * pixel_size);
+}
+
+bool
+CC::MandelbrotStashData::allows_interior_test() const
+{
+	// Orbits of points in the set never leave the radius 2 disk.
+	return power == 2 && jdepth == 0 && blackhole && bailout >= 2;
 }
 
 CC::PickoverStashData::PickoverStashData(